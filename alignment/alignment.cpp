@@ -3,10 +3,20 @@
 //
 
 #include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
 #include <vector>
 #include <cmath>
 #include <omp.h>
 #include "alignment.hpp"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMILARITY_SIMD_X86
+#include <immintrin.h>
+#endif
 
 double alignmentScore(std::vector<double>& matrix, const int* a, const int* b, int columns, double interval, int gapScore) {
 	int sideLength = columns + 1;
@@ -49,11 +59,23 @@ inline double moderate(double x) {
 	return V_PLUS_B * x / (x  + B);
 }
 
-inline double pixelDistance(const Sequence* p1, int indexP1, const Sequence* p2, int indexP2) {
-	return moderate(
-			std::abs(p1->r[indexP1] - p2->r[indexP2])
-			+ std::abs(p1->g[indexP1] - p2->g[indexP2])
-			+ std::abs(p1->b[indexP1] - p2->b[indexP2]));
+// View on channels of one packed sequence.
+struct PackedSequence {
+	const unsigned char* r;
+	const unsigned char* g;
+	const unsigned char* b;
+};
+
+// Similarity functions below work on any pixel source S with r, g and b channel arrays:
+// Sequence (int channels) or PackedSequence (byte channels).
+
+// L1 distance between two pixels. As moderate() is increasing, the minimum of moderated distances
+// is the moderated minimum distance, so distances are moderated only once per pixel.
+template <typename S>
+inline int pixelDistance(const S* p1, int indexP1, const S* p2, int indexP2) {
+	return std::abs(p1->r[indexP1] - p2->r[indexP2])
+		   + std::abs(p1->g[indexP1] - p2->g[indexP2])
+		   + std::abs(p1->b[indexP1] - p2->b[indexP2]);
 }
 
 #define PIXEL_DISTANCE(p1, x, y, p2, localX, localY, width) pixelDistance(p1, (x) + (y) * (width), p2, (localX) + (localY) * (width))
@@ -92,97 +114,520 @@ inline T getMin(T t1, T t2, T t3, T t4, T t5, T t6, T t7, T t8, T t9) {
 	return val;
 }
 
-inline double compareFaster(const Sequence* p1, const Sequence* p2, int width, int height, int maximumSimilarityScore) {
+// Sum of moderated minimum distances of pixels x in [xFrom; width - 2] of row y, compared to their 3x3 neighbourhood.
+template <typename S>
+inline double interiorRowDistanceScalar(const S* p1, const S* p2, int width, int y, int xFrom) {
+	double totalDistance = 0;
+	for (int x = xFrom; x <= width - 2; ++x) {
+		totalDistance += moderate(getMin(
+				PIXEL_DISTANCE(p1, x, y, p2, x - 1, y - 1, width),
+				PIXEL_DISTANCE(p1, x, y, p2, x, y - 1, width),
+				PIXEL_DISTANCE(p1, x, y, p2, x + 1, y - 1, width),
+				PIXEL_DISTANCE(p1, x, y, p2, x - 1, y, width),
+				PIXEL_DISTANCE(p1, x, y, p2, x, y, width),
+				PIXEL_DISTANCE(p1, x, y, p2, x + 1, y, width),
+				PIXEL_DISTANCE(p1, x, y, p2, x - 1, y + 1, width),
+				PIXEL_DISTANCE(p1, x, y, p2, x, y + 1, width),
+				PIXEL_DISTANCE(p1, x, y, p2, x + 1, y + 1, width)));
+	}
+	return totalDistance;
+}
+
+#ifdef SIMILARITY_SIMD_X86
+
+// Load 4 or 8 consecutive channel values as 32-bit integers.
+__attribute__((target("sse4.1")))
+inline __m128i loadPixels4(const int* values) {
+	return _mm_loadu_si128((const __m128i*) values);
+}
+
+__attribute__((target("sse4.1")))
+inline __m128i loadPixels4(const unsigned char* values) {
+	int packed;
+	memcpy(&packed, values, sizeof(packed));
+	return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+}
+
+__attribute__((target("avx2")))
+inline __m256i loadPixels8(const int* values) {
+	return _mm256_loadu_si256((const __m256i*) values);
+}
+
+__attribute__((target("avx2")))
+inline __m256i loadPixels8(const unsigned char* values) {
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) values));
+}
+
+// Same as interiorRowDistanceScalar(), 4 pixels at once.
+// Lanes are summed separately, so result may differ from scalar one by rounding only.
+template <typename S>
+__attribute__((target("sse4.1")))
+double interiorRowDistanceSSE41(const S* p1, const S* p2, int width, int y, int xFrom) {
+	const __m128d vPlusB = _mm_set1_pd(V_PLUS_B);
+	const __m128d b = _mm_set1_pd(B);
+	__m128d sum = _mm_setzero_pd();
+	int x = xFrom;
+	for (; x + 4 <= width - 1; x += 4) {
+		int index = x + y * width;
+		__m128i r1 = loadPixels4(p1->r + index);
+		__m128i g1 = loadPixels4(p1->g + index);
+		__m128i b1 = loadPixels4(p1->b + index);
+		__m128i minDistance = _mm_set1_epi32(INT_MAX);
+		for (int dy = -1; dy <= 1; ++dy) {
+			for (int dx = -1; dx <= 1; ++dx) {
+				int localIndex = index + dx + dy * width;
+				__m128i distance = _mm_add_epi32(
+						_mm_add_epi32(
+								_mm_abs_epi32(_mm_sub_epi32(r1, loadPixels4(p2->r + localIndex))),
+								_mm_abs_epi32(_mm_sub_epi32(g1, loadPixels4(p2->g + localIndex)))),
+						_mm_abs_epi32(_mm_sub_epi32(b1, loadPixels4(p2->b + localIndex))));
+				minDistance = _mm_min_epi32(minDistance, distance);
+			}
+		}
+		__m128d low = _mm_cvtepi32_pd(minDistance);
+		__m128d high = _mm_cvtepi32_pd(_mm_srli_si128(minDistance, 8));
+		sum = _mm_add_pd(sum, _mm_div_pd(_mm_mul_pd(vPlusB, low), _mm_add_pd(low, b)));
+		sum = _mm_add_pd(sum, _mm_div_pd(_mm_mul_pd(vPlusB, high), _mm_add_pd(high, b)));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, sum);
+	return lanes[0] + lanes[1] + interiorRowDistanceScalar(p1, p2, width, y, x);
+}
+
+// Same as interiorRowDistanceSSE41(), 8 pixels at once. Remaining pixels are handled 4 at once.
+template <typename S>
+__attribute__((target("avx2")))
+double interiorRowDistanceAVX2(const S* p1, const S* p2, int width, int y, int xFrom) {
+	const __m256d vPlusB = _mm256_set1_pd(V_PLUS_B);
+	const __m256d b = _mm256_set1_pd(B);
+	__m256d sum = _mm256_setzero_pd();
+	int x = xFrom;
+	for (; x + 8 <= width - 1; x += 8) {
+		int index = x + y * width;
+		__m256i r1 = loadPixels8(p1->r + index);
+		__m256i g1 = loadPixels8(p1->g + index);
+		__m256i b1 = loadPixels8(p1->b + index);
+		__m256i minDistance = _mm256_set1_epi32(INT_MAX);
+		for (int dy = -1; dy <= 1; ++dy) {
+			for (int dx = -1; dx <= 1; ++dx) {
+				int localIndex = index + dx + dy * width;
+				__m256i distance = _mm256_add_epi32(
+						_mm256_add_epi32(
+								_mm256_abs_epi32(_mm256_sub_epi32(r1, loadPixels8(p2->r + localIndex))),
+								_mm256_abs_epi32(_mm256_sub_epi32(g1, loadPixels8(p2->g + localIndex)))),
+						_mm256_abs_epi32(_mm256_sub_epi32(b1, loadPixels8(p2->b + localIndex))));
+				minDistance = _mm256_min_epi32(minDistance, distance);
+			}
+		}
+		__m256d low = _mm256_cvtepi32_pd(_mm256_castsi256_si128(minDistance));
+		__m256d high = _mm256_cvtepi32_pd(_mm256_extracti128_si256(minDistance, 1));
+		sum = _mm256_add_pd(sum, _mm256_div_pd(_mm256_mul_pd(vPlusB, low), _mm256_add_pd(low, b)));
+		sum = _mm256_add_pd(sum, _mm256_div_pd(_mm256_mul_pd(vPlusB, high), _mm256_add_pd(high, b)));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, sum);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + interiorRowDistanceSSE41(p1, p2, width, y, x);
+}
+
+#endif
+
+// May be set while other threads classify: each classification reads it once, when it starts.
+static std::atomic<int> similaritySimd(SIMILARITY_SIMD_AVX2);
+
+void setSimilaritySimd(int level) {
+	similaritySimd.store(level);
+}
+
+// Requested SIMD level, capped by CPU support.
+int getSimilaritySimd() {
+#ifdef SIMILARITY_SIMD_X86
+	int level = similaritySimd.load();
+	if (level >= SIMILARITY_SIMD_AVX2 && __builtin_cpu_supports("avx2"))
+		return SIMILARITY_SIMD_AVX2;
+	if (level >= SIMILARITY_SIMD_SSE41 && __builtin_cpu_supports("sse4.1"))
+		return SIMILARITY_SIMD_SSE41;
+#endif
+	return SIMILARITY_SIMD_SCALAR;
+}
+
+template <typename S>
+inline double interiorRowDistance(const S* p1, const S* p2, int width, int y, int simd) {
+#ifdef SIMILARITY_SIMD_X86
+	if (simd == SIMILARITY_SIMD_AVX2)
+		return interiorRowDistanceAVX2(p1, p2, width, y, 1);
+	if (simd == SIMILARITY_SIMD_SSE41)
+		return interiorRowDistanceSSE41(p1, p2, width, y, 1);
+#endif
+	return interiorRowDistanceScalar(p1, p2, width, y, 1);
+}
+
+// Return similarity score, or SIMILARITY_PRUNED as soon as total distance exceeds maxDistance.
+// Number of compared pixels is added to comparedPixels.
+template <typename S>
+inline double compareFaster(const S* p1, const S* p2, int width, int height, int maximumSimilarityScore,
+							 int simd, double maxDistance, int64_t& comparedPixels) {
 	// x, y:
 	// 0, 0
-	double totalDistance = getMin(
+	double totalDistance = moderate(getMin(
 			PIXEL_DISTANCE(p1, 0 ,0, p2, 0, 0, width),
 			PIXEL_DISTANCE(p1, 0 ,0, p2, 1, 0, width),
 			PIXEL_DISTANCE(p1, 0 ,0, p2, 0, 1, width),
-			PIXEL_DISTANCE(p1, 0 ,0, p2, 1, 1, width));
+			PIXEL_DISTANCE(p1, 0 ,0, p2, 1, 1, width)));
 	// width - 1, 0
-	totalDistance += getMin(
+	totalDistance += moderate(getMin(
 			PIXEL_DISTANCE(p1, width - 1, 0, p2, width - 2, 0, width),
 			PIXEL_DISTANCE(p1, width - 1, 0, p2, width - 1, 0, width),
 			PIXEL_DISTANCE(p1, width - 1, 0, p2, width - 2, 1, width),
-			PIXEL_DISTANCE(p1, width - 1, 0, p2, width - 1, 1, width));
+			PIXEL_DISTANCE(p1, width - 1, 0, p2, width - 1, 1, width)));
 	// 0, height - 1
-	totalDistance += getMin(
+	totalDistance += moderate(getMin(
 			PIXEL_DISTANCE(p1, 0, height - 1, p2, 0, height - 1, width),
 			PIXEL_DISTANCE(p1, 0, height - 1, p2, 1, height - 1, width),
 			PIXEL_DISTANCE(p1, 0, height - 1, p2, 0, height - 2, width),
-			PIXEL_DISTANCE(p1, 0, height - 1, p2, 1, height - 2, width));
+			PIXEL_DISTANCE(p1, 0, height - 1, p2, 1, height - 2, width)));
 	// width - 1, height - 1
-	totalDistance += getMin(
+	totalDistance += moderate(getMin(
 			PIXEL_DISTANCE(p1, width - 1, height - 1, p2, width - 2, height - 1, width),
 			PIXEL_DISTANCE(p1, width - 1, height - 1, p2, width - 1, height - 1, width),
 			PIXEL_DISTANCE(p1, width - 1, height - 1, p2, width - 2, height - 2, width),
-			PIXEL_DISTANCE(p1, width - 1, height - 1, p2, width - 1, height - 2, width));
+			PIXEL_DISTANCE(p1, width - 1, height - 1, p2, width - 1, height - 2, width)));
 	// x, 0
 	for (int x = 1; x <= width - 2; ++x) {
-		totalDistance += getMin(
+		totalDistance += moderate(getMin(
 				PIXEL_DISTANCE(p1, x, 0, p2, x - 1, 0, width),
 				PIXEL_DISTANCE(p1, x, 0, p2, x, 0, width),
 				PIXEL_DISTANCE(p1, x, 0, p2, x + 1, 0, width),
 				PIXEL_DISTANCE(p1, x, 0, p2, x - 1, 1, width),
 				PIXEL_DISTANCE(p1, x, 0, p2, x, 1, width),
-				PIXEL_DISTANCE(p1, x, 0, p2, x + 1, 1, width));
+				PIXEL_DISTANCE(p1, x, 0, p2, x + 1, 1, width)));
 	}
 	// x, height - 1
 	for (int x = 1; x <= width - 2; ++x) {
-		totalDistance += getMin(
+		totalDistance += moderate(getMin(
 				PIXEL_DISTANCE(p1, x, height - 1, p2, x - 1, height - 1, width),
 				PIXEL_DISTANCE(p1, x, height - 1, p2, x, height - 1, width),
 				PIXEL_DISTANCE(p1, x, height - 1, p2, x + 1, height - 1, width),
 				PIXEL_DISTANCE(p1, x, height - 1, p2, x - 1, height - 2, width),
 				PIXEL_DISTANCE(p1, x, height - 1, p2, x, height - 2, width),
-				PIXEL_DISTANCE(p1, x, height - 1, p2, x + 1, height - 2, width));
+				PIXEL_DISTANCE(p1, x, height - 1, p2, x + 1, height - 2, width)));
 	}
 	for (int y = 1; y <= height - 2; ++y) {
 		// 0, y
-		totalDistance += getMin(
+		totalDistance += moderate(getMin(
 				PIXEL_DISTANCE(p1, 0, y, p2, 0, y - 1, width),
 				PIXEL_DISTANCE(p1, 0, y, p2, 1, y - 1, width),
 				PIXEL_DISTANCE(p1, 0, y, p2, 0, y, width),
 				PIXEL_DISTANCE(p1, 0, y, p2, 1, y, width),
 				PIXEL_DISTANCE(p1, 0, y, p2, 0, y + 1, width),
-				PIXEL_DISTANCE(p1, 0, y, p2, 1, y + 1, width));
+				PIXEL_DISTANCE(p1, 0, y, p2, 1, y + 1, width)));
 		// width - 1, y
-		totalDistance += getMin(
+		totalDistance += moderate(getMin(
 				PIXEL_DISTANCE(p1, width - 1, y, p2, width - 2, y - 1, width),
 				PIXEL_DISTANCE(p1, width - 1, y, p2, width - 1, y - 1, width),
 				PIXEL_DISTANCE(p1, width - 1, y, p2, width - 2, y, width),
 				PIXEL_DISTANCE(p1, width - 1, y, p2, width - 1, y, width),
 				PIXEL_DISTANCE(p1, width - 1, y, p2, width - 2, y + 1, width),
-				PIXEL_DISTANCE(p1, width - 1, y, p2, width - 1, y + 1, width));
+				PIXEL_DISTANCE(p1, width - 1, y, p2, width - 1, y + 1, width)));
 	}
+	int64_t pixels = 2 * width + 2 * (height - 2);
 	// x in [1; width - 2], y in [1; height - 2]
-	int remainingSize = (width - 2) * (height - 2);
-	for (int index = 0; index < remainingSize; ++index) {
-		int x = index % (width - 2) + 1;
-		int y = index / (width - 2) + 1;
-		totalDistance += getMin(
-				PIXEL_DISTANCE(p1, x, y, p2, x - 1, y - 1, width),
-				PIXEL_DISTANCE(p1, x, y, p2, x, y - 1, width),
-				PIXEL_DISTANCE(p1, x, y, p2, x + 1, y - 1, width),
-				PIXEL_DISTANCE(p1, x, y, p2, x - 1, y, width),
-				PIXEL_DISTANCE(p1, x, y, p2, x, y, width),
-				PIXEL_DISTANCE(p1, x, y, p2, x + 1, y, width),
-				PIXEL_DISTANCE(p1, x, y, p2, x - 1, y + 1, width),
-				PIXEL_DISTANCE(p1, x, y, p2, x, y + 1, width),
-				PIXEL_DISTANCE(p1, x, y, p2, x + 1, y + 1, width));
+	// Distances are non-negative, so pair can be abandoned as soon as total exceeds maxDistance.
+	for (int y = 1; y <= height - 2 && totalDistance <= maxDistance; ++y) {
+		totalDistance += interiorRowDistance(p1, p2, width, y, simd);
+		pixels += width - 2;
 	}
+	comparedPixels += pixels;
+	if (totalDistance > maxDistance)
+		return SIMILARITY_PRUNED;
 	return (maximumSimilarityScore - totalDistance) / maximumSimilarityScore;
 }
 
-void classifySimilarities(
-		Sequence** sequences, int nbSequences, int iFrom, int iTo, int width, int height, double* edges) {
+// Pixel data budget for one tile: both blocks of sequences of a tile should fit in L2 cache.
+const size_t SIMILARITY_TILE_CACHE_BYTES = 512 * 1024;
+
+struct SimilarityTile {
+	int iStart, iEnd; // Rows block.
+	int jStart, jEnd; // Columns block.
+};
+
+// Split upper triangle of rows [iFrom, iTo) x columns [iFrom, nbSequences) into blocks of blockSize sequences.
+// Only tiles holding at least one pair j > i are kept.
+std::vector<SimilarityTile> getSimilarityTiles(int nbSequences, int iFrom, int iTo, int blockSize) {
+	std::vector<SimilarityTile> tiles;
+	for (int iStart = iFrom; iStart < iTo; iStart += blockSize) {
+		int iEnd = std::min(iStart + blockSize, iTo);
+		for (int jStart = iStart; jStart < nbSequences; jStart += blockSize)
+			tiles.push_back({iStart, iEnd, jStart, std::min(jStart + blockSize, nbSequences)});
+	}
+	return tiles;
+}
+
+inline void SimilarityPruning_set(SimilarityPruning* pruning, int64_t nbPairs, int64_t nbSurvivors,
+								  int64_t comparedPixels, int width, int height) {
+	pruning->nbPairs = nbPairs;
+	pruning->nbSurvivors = nbSurvivors;
+	pruning->workSkipped = nbPairs ? 1 - (double) comparedPixels / ((double) nbPairs * width * height) : 0;
+}
+
+// Output of classifyTiles() writing all scores into dense edges matrix.
+class DenseEdgesOutput {
+	double* edges;
+	int nbSequences;
+public:
+	typedef DenseEdgesOutput Buffer;
+
+	DenseEdgesOutput(double* edgesMatrix, int n): edges(edgesMatrix), nbSequences(n) {}
+
+	Buffer makeBuffer() {
+		return *this;
+	}
+
+	void add(int i, int j, double score) {
+		edges[(size_t) i * nbSequences + j] = score;
+	}
+
+	void merge(Buffer&) {}
+};
+
+// Key used to rank neighbours of a sequence: best score first, then lowest neighbour index, so that
+// ranking does not depend on order in which pairs were compared.
+inline bool isBetterNeighbour(double score1, int neighbour1, double score2, int neighbour2) {
+	return score1 > score2 || (score1 == score2 && neighbour1 < neighbour2);
+}
+
+// Keep only edges which are among the k best neighbours of at least one of their sequences.
+// An edge dropped from a subset of edges would also be dropped from whole set, so selection can be applied
+// to partial buffers to bound their size.
+void selectTopNeighbours(std::vector<SimilarityEdge>& edges, int k) {
+	struct Endpoint {
+		int sequence;
+		int neighbour;
+		double score;
+		size_t edge;
+	};
+	std::vector<Endpoint> endpoints;
+	endpoints.reserve(2 * edges.size());
+	for (size_t e = 0; e < edges.size(); ++e) {
+		endpoints.push_back({edges[e].i, edges[e].j, edges[e].score, e});
+		endpoints.push_back({edges[e].j, edges[e].i, edges[e].score, e});
+	}
+	std::sort(endpoints.begin(), endpoints.end(), [](const Endpoint& a, const Endpoint& b) {
+		return a.sequence < b.sequence
+			   || (a.sequence == b.sequence && isBetterNeighbour(a.score, a.neighbour, b.score, b.neighbour));
+	});
+	std::vector<bool> keep(edges.size(), false);
+	int rank = 0;
+	for (size_t e = 0; e < endpoints.size(); ++e) {
+		rank = (e && endpoints[e].sequence == endpoints[e - 1].sequence) ? rank + 1 : 0;
+		if (rank < k)
+			keep[endpoints[e].edge] = true;
+	}
+	size_t nbKept = 0;
+	for (size_t e = 0; e < edges.size(); ++e)
+		if (keep[e])
+			edges[nbKept++] = edges[e];
+	edges.resize(nbKept);
+}
+
+// Output of classifyTiles() collecting kept pairs only, into one growable buffer per thread.
+// If topK > 0, buffers are regularly reduced to top-K neighbours of each sequence, so that memory
+// is bounded by number of sequences times topK.
+class SparseEdgesOutput {
+	std::vector<SimilarityEdge> edges;
+	std::mutex mutex;
+	int nbSequences;
+	int topK;
+public:
+	class Buffer {
+		std::vector<SimilarityEdge> edges;
+		size_t limit;
+		int topK;
+		friend class SparseEdgesOutput;
+	public:
+		Buffer(int nbSequences, int k):
+				edges(), limit(std::max((size_t) 2 * nbSequences * k, (size_t) 65536)), topK(k) {}
+
+		void add(int i, int j, double score) {
+			if (score == SIMILARITY_PRUNED)
+				return;
+			edges.push_back({i, j, score});
+			if (topK > 0 && edges.size() >= limit) {
+				selectTopNeighbours(edges, topK);
+				limit = std::max(limit, 2 * edges.size());
+			}
+		}
+	};
+
+	SparseEdgesOutput(int n, int k): edges(), mutex(), nbSequences(n), topK(k) {}
+
+	Buffer makeBuffer() {
+		return Buffer(nbSequences, topK);
+	}
+
+	void merge(Buffer& buffer) {
+		std::lock_guard<std::mutex> lock(mutex);
+		edges.insert(edges.end(), buffer.edges.begin(), buffer.edges.end());
+	}
+
+	// Select top-K neighbours on merged edges, and give them sorted by i then j.
+	void finish(SimilarityEdges* output) {
+		if (topK > 0)
+			selectTopNeighbours(edges, topK);
+		std::sort(edges.begin(), edges.end(), [](const SimilarityEdge& a, const SimilarityEdge& b) {
+			return a.i < b.i || (a.i == b.i && a.j < b.j);
+		});
+		output->nbEdges = edges.size();
+		output->edges = edges.empty() ? nullptr : new SimilarityEdge[edges.size()];
+		std::copy(edges.begin(), edges.end(), output->edges);
+	}
+};
+
+// Compare rows [iFrom, iTo) to following sequences, tile by tile.
+// sequenceBytes is size of compared pixel data of one sequence.
+// Pairs with similarity below minSimilarity get SIMILARITY_PRUNED. Scores are given to output,
+// through one output buffer per thread. Statistics are written into pruning if not null.
+template <typename S, typename Output>
+void classifyTiles(const S* const* sequences, int nbSequences, int iFrom, int iTo, int width, int height,
+				   size_t sequenceBytes, double minSimilarity, Output& output, SimilarityPruning* pruning) {
 	iTo = std::min(iTo, nbSequences);
+	int64_t nbPairs = 0;
+	int64_t nbSurvivors = 0;
+	int64_t comparedPixels = 0;
+	if (iFrom >= iTo) {
+		if (pruning)
+			SimilarityPruning_set(pruning, 0, 0, 0, width, height);
+		return;
+	}
 	int maximumSimilarityScore = SIMPLE_MAX_PIXEL_DISTANCE * width * height;
-	for (int i = iFrom; i < iTo; ++i) {
-		#pragma omp parallel for default(none) shared(sequences, i, nbSequences, width, height, maximumSimilarityScore, edges)
-		for (int j = i + 1; j < nbSequences; ++j) {
-			edges[i * nbSequences + j] = compareFaster(sequences[i], sequences[j], width, height, maximumSimilarityScore);
+	// score >= minSimilarity <=> totalDistance <= maxDistance (infinite if minSimilarity is -INFINITY).
+	double maxDistance = maximumSimilarityScore * (1 - minSimilarity);
+	int blockSize = (int) std::max((size_t) 1, SIMILARITY_TILE_CACHE_BYTES / (2 * sequenceBytes));
+	std::vector<SimilarityTile> tiles = getSimilarityTiles(nbSequences, iFrom, iTo, blockSize);
+	int nbTiles = (int) tiles.size();
+	int simd = getSimilaritySimd();
+	// One parallel region for all pairs. Tiles have different sizes (diagonal tiles are half full),
+	// so they are distributed dynamically.
+	#pragma omp parallel reduction(+:nbPairs, nbSurvivors, comparedPixels) default(none) shared(sequences, width, height, maximumSimilarityScore, minSimilarity, maxDistance, output, tiles, nbTiles, simd)
+	{
+		typename Output::Buffer buffer = output.makeBuffer();
+		#pragma omp for schedule(dynamic)
+		for (int t = 0; t < nbTiles; ++t) {
+			const SimilarityTile& tile = tiles[t];
+			for (int i = tile.iStart; i < tile.iEnd; ++i) {
+				for (int j = std::max(i + 1, tile.jStart); j < tile.jEnd; ++j) {
+					double score = compareFaster(
+							sequences[i], sequences[j], width, height, maximumSimilarityScore, simd, maxDistance,
+							comparedPixels);
+					if (score < minSimilarity)
+						score = SIMILARITY_PRUNED;
+					else
+						++nbSurvivors;
+					++nbPairs;
+					buffer.add(i, j, score);
+				}
+			}
 		}
+		output.merge(buffer);
 	}
+	if (pruning)
+		SimilarityPruning_set(pruning, nbPairs, nbSurvivors, comparedPixels, width, height);
+}
+
+// Views on channels of packed sequences, valid while packed sequences live.
+void getPackedViews(const PackedSequences* packed, std::vector<PackedSequence>& views,
+					std::vector<const PackedSequence*>& pViews) {
+	size_t size = (size_t) packed->width * packed->height;
+	views.resize((size_t) packed->nbSequences);
+	pViews.resize((size_t) packed->nbSequences);
+	for (int k = 0; k < packed->nbSequences; ++k) {
+		const unsigned char* r = packed->data + packed->stride * k;
+		views[k] = {r, r + size, r + 2 * size};
+		pViews[k] = &views[k];
+	}
+}
+
+void classifySimilarities(
+		Sequence** sequences, int nbSequences, int iFrom, int iTo, int width, int height, double* edges) {
+	classifySimilaritiesAbove(sequences, nbSequences, iFrom, iTo, width, height, -INFINITY, edges, nullptr);
+}
+
+void classifySimilaritiesAbove(Sequence** sequences, int nbSequences, int iFrom, int iTo, int width, int height,
+							   double minSimilarity, double* edges, SimilarityPruning* pruning) {
+	DenseEdgesOutput output(edges, nbSequences);
+	// Compared channels are r, g and b.
+	classifyTiles(sequences, nbSequences, iFrom, iTo, width, height, 3 * sizeof(int) * width * height,
+				  minSimilarity, output, pruning);
+}
+
+void classifySimilaritiesSparse(Sequence** sequences, int nbSequences, int iFrom, int iTo, int width, int height,
+								double minSimilarity, int topK, SimilarityEdges* edges, SimilarityPruning* pruning) {
+	SparseEdgesOutput output(nbSequences, topK);
+	classifyTiles(sequences, nbSequences, iFrom, iTo, width, height, 3 * sizeof(int) * width * height,
+				  minSimilarity, output, pruning);
+	output.finish(edges);
+}
+
+bool PackedSequences_init(PackedSequences* packed, Sequence** sequences, int nbSequences, int width, int height) {
+	size_t size = (size_t) width * height;
+	packed->nbSequences = nbSequences;
+	packed->width = width;
+	packed->height = height;
+	packed->stride = (3 * size + PACKED_SEQUENCE_ALIGNMENT - 1) / PACKED_SEQUENCE_ALIGNMENT * PACKED_SEQUENCE_ALIGNMENT;
+	packed->buffer = malloc(packed->stride * nbSequences + PACKED_SEQUENCE_ALIGNMENT);
+	if (!packed->buffer) {
+		packed->data = nullptr;
+		return false;
+	}
+	uintptr_t address = (uintptr_t) packed->buffer;
+	packed->data = (unsigned char*) ((address + PACKED_SEQUENCE_ALIGNMENT - 1) / PACKED_SEQUENCE_ALIGNMENT * PACKED_SEQUENCE_ALIGNMENT);
+	#pragma omp parallel for default(none) shared(packed, sequences, nbSequences, size)
+	for (int k = 0; k < nbSequences; ++k) {
+		unsigned char* r = packed->data + packed->stride * k;
+		unsigned char* g = r + size;
+		unsigned char* b = g + size;
+		for (size_t index = 0; index < size; ++index) {
+			r[index] = (unsigned char) std::min(std::max(sequences[k]->r[index], 0), 255);
+			g[index] = (unsigned char) std::min(std::max(sequences[k]->g[index], 0), 255);
+			b[index] = (unsigned char) std::min(std::max(sequences[k]->b[index], 0), 255);
+		}
+		memset(b + size, 0, packed->stride - 3 * size);
+	}
+	return true;
+}
+
+void PackedSequences_clear(PackedSequences* packed) {
+	free(packed->buffer);
+	packed->buffer = nullptr;
+	packed->data = nullptr;
+}
+
+void classifyPackedSimilarities(const PackedSequences* packed, int iFrom, int iTo, double* edges) {
+	classifyPackedSimilaritiesAbove(packed, iFrom, iTo, -INFINITY, edges, nullptr);
+}
+
+void classifyPackedSimilaritiesAbove(const PackedSequences* packed, int iFrom, int iTo, double minSimilarity,
+									 double* edges, SimilarityPruning* pruning) {
+	std::vector<PackedSequence> views;
+	std::vector<const PackedSequence*> pViews;
+	getPackedViews(packed, views, pViews);
+	DenseEdgesOutput output(edges, packed->nbSequences);
+	classifyTiles(pViews.data(), packed->nbSequences, iFrom, iTo, packed->width, packed->height,
+				  packed->stride, minSimilarity, output, pruning);
+}
+
+void classifyPackedSimilaritiesSparse(const PackedSequences* packed, int iFrom, int iTo, double minSimilarity,
+									  int topK, SimilarityEdges* edges, SimilarityPruning* pruning) {
+	std::vector<PackedSequence> views;
+	std::vector<const PackedSequence*> pViews;
+	getPackedViews(packed, views, pViews);
+	SparseEdgesOutput output(packed->nbSequences, topK);
+	classifyTiles(pViews.data(), packed->nbSequences, iFrom, iTo, packed->width, packed->height,
+				  packed->stride, minSimilarity, output, pruning);
+	output.finish(edges);
+}
+
+void SimilarityEdges_clear(SimilarityEdges* edges) {
+	delete[] edges->edges;
+	edges->edges = nullptr;
+	edges->nbEdges = 0;
 }
@@ -5,6 +5,9 @@
 #ifndef VIDEORAPTOR_ALIGNMENT_HPP
 #define VIDEORAPTOR_ALIGNMENT_HPP
 
+#include <cstddef>
+#include <cstdint>
+
 struct Sequence {
 	int* r; // red
 	int* g; // green
@@ -14,12 +17,86 @@ struct Sequence {
 	int classification;
 };
 
+// Sequences with r, g and b channels stored as bytes (gray is not used to compare sequences).
+// For each sequence, r, g and b planes follow each other, and each sequence starts on a 64-byte boundary.
+// A 32x32 sequence takes 3 KiB instead of 16 KiB for a Sequence.
+// Build with PackedSequences_init(), free with PackedSequences_clear().
+#define PACKED_SEQUENCE_ALIGNMENT 64
+
+struct PackedSequences {
+	unsigned char* data;
+	void* buffer; // Allocated memory holding data.
+	size_t stride; // Bytes from one sequence to next: 3 * width * height rounded up to alignment.
+	int nbSequences;
+	int width;
+	int height;
+};
+
+// Edge value of pairs abandoned by classifySimilaritiesAbove() because their similarity is below threshold.
+#define SIMILARITY_PRUNED -1.0
+
+// Statistics of a threshold-pruned classification.
+struct SimilarityPruning {
+	int64_t nbPairs; // Number of pairs classified.
+	int64_t nbSurvivors; // Number of pairs with similarity at or above threshold.
+	double workSkipped; // Fraction of pixel comparisons skipped by abandoning pairs early.
+};
+
+// Pair of sequences i < j with their similarity score.
+struct SimilarityEdge {
+	int i;
+	int j;
+	double score;
+};
+
+// Edges kept by sparse classification, sorted by i then j. Free with SimilarityEdges_clear().
+struct SimilarityEdges {
+	SimilarityEdge* edges;
+	size_t nbEdges;
+};
+
+// SIMD levels for classifySimilarities() and classifyPackedSimilarities(). All levels take minimum distance
+// of each pixel before moderating it, and differ only by summation order: scores match each other,
+// and scores of previous per-distance scalar code, within 1e-9.
+enum SimilaritySimd {
+	SIMILARITY_SIMD_SCALAR = 0,
+	SIMILARITY_SIMD_SSE41 = 1,
+	SIMILARITY_SIMD_AVX2 = 2,
+};
+
 
 extern "C" {
 	double batchAlignmentScore(
 			const int* A, const int* B, int rows, int columns, int minVal, int maxVal, int gapScore);
 	void classifySimilarities(
 			Sequence** sequences, int nbSequences, int from, int to, int width, int height, double* edges);
+	// Same as classifySimilarities(), but pairs with similarity below minSimilarity get SIMILARITY_PRUNED.
+	// Distance is accumulated row by row, and a pair is abandoned as soon as its score cannot reach minSimilarity.
+	// If pruning is not null, it receives statistics about skipped work.
+	void classifySimilaritiesAbove(Sequence** sequences, int nbSequences, int from, int to, int width, int height,
+								   double minSimilarity, double* edges, SimilarityPruning* pruning);
+	// Same as classifySimilaritiesAbove(), but only kept pairs are returned, as a list of edges instead of
+	// a nbSequences x nbSequences matrix, so memory grows with number of matches.
+	// If topK > 0, only edges among the topK best neighbours of at least one of their sequences are kept.
+	// Previous content of edges is not freed.
+	void classifySimilaritiesSparse(Sequence** sequences, int nbSequences, int from, int to, int width, int height,
+									double minSimilarity, int topK, SimilarityEdges* edges, SimilarityPruning* pruning);
+	void SimilarityEdges_clear(SimilarityEdges* edges);
+	// Convert sequences once into packed layout. Channel values are clamped to [0, 255].
+	// Return false if memory could not be allocated.
+	bool PackedSequences_init(PackedSequences* packed, Sequence** sequences, int nbSequences, int width, int height);
+	void PackedSequences_clear(PackedSequences* packed);
+	// Same as classifySimilarities(), on packed sequences. Give same edges if channel values are in [0, 255].
+	void classifyPackedSimilarities(const PackedSequences* packed, int from, int to, double* edges);
+	// Same as classifySimilaritiesAbove(), on packed sequences.
+	void classifyPackedSimilaritiesAbove(const PackedSequences* packed, int from, int to, double minSimilarity,
+										 double* edges, SimilarityPruning* pruning);
+	// Same as classifySimilaritiesSparse(), on packed sequences.
+	void classifyPackedSimilaritiesSparse(const PackedSequences* packed, int from, int to, double minSimilarity,
+										  int topK, SimilarityEdges* edges, SimilarityPruning* pruning);
+	// Set maximum SIMD level used by next classifySimilarities() and classifyPackedSimilarities() calls (default AVX2).
+	// Level is capped by CPU support at each call. Thread-safe: calls already running keep their level.
+	void setSimilaritySimd(int level);
 };
 
 #endif //VIDEORAPTOR_ALIGNMENT_HPP
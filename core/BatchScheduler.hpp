@@ -0,0 +1,108 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_BATCHSCHEDULER_HPP
+#define VIDEORAPTOR_BATCHSCHEDULER_HPP
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#ifdef WIN32
+#include "compatWindows.hpp"
+#endif
+
+enum VideoRaptorScheduler {
+	SCHEDULER_WORK_STEALING = 0,	// Largest files first, idle workers steal from busy ones.
+	SCHEDULER_STATIC = 1,			// Each worker gets a contiguous slice of the batch.
+};
+
+// Cheap cost estimate for a video: its file size. Return 0 if file size cannot be read
+// (then file is just scheduled among the last ones).
+inline size_t estimateVideoCost(const char* filename) {
+	size_t size = 0;
+	if (!filename)
+		return 0;
+#ifdef WIN32
+	fileSize(filename, &size);
+#else
+	struct stat buf;
+	if (stat(filename, &buf) == 0)
+		size = (size_t) buf.st_size;
+#endif
+	return size;
+}
+
+// Videos at least this big (in bytes, e.g. long or high-resolution movies) are worth decoding with many threads:
+// when a batch contains such videos, automatic thread distribution gives each worker at least
+// LARGE_VIDEO_DECODE_THREADS processors.
+#define LARGE_VIDEO_COST ((size_t) 256 << 20)
+#define LARGE_VIDEO_DECODE_THREADS 4
+
+// Distribute batch item indices to workers. Each worker pops items from the front of its own queue.
+// When its queue is empty, it steals from the back of the most loaded queue.
+class BatchScheduler {
+	struct WorkerQueue {
+		std::vector<int> indices;
+		size_t head;
+		size_t tail;
+		std::mutex mutex;
+		WorkerQueue(): indices(), head(0), tail(0), mutex() {}
+	};
+	std::vector<WorkerQueue> queues;
+
+	bool pop(int worker, int* index) {
+		WorkerQueue& queue = queues[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.head == queue.tail)
+			return false;
+		*index = queue.indices[queue.head++];
+		return true;
+	}
+
+	bool steal(int* index) {
+		while (true) {
+			// Find the most loaded queue.
+			int victim = -1;
+			size_t victimLoad = 0;
+			for (size_t i = 0; i < queues.size(); ++i) {
+				std::lock_guard<std::mutex> lock(queues[i].mutex);
+				if (queues[i].tail - queues[i].head > victimLoad) {
+					victim = (int) i;
+					victimLoad = queues[i].tail - queues[i].head;
+				}
+			}
+			if (victim < 0)
+				return false;
+			WorkerQueue& queue = queues[victim];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			// Queue may have been emptied meanwhile. Then retry.
+			if (queue.head != queue.tail) {
+				*index = queue.indices[--queue.tail];
+				return true;
+			}
+		}
+	}
+
+public:
+	// Items are dealt round-robin to workers by decreasing cost,
+	// so that each worker starts with the largest files.
+	BatchScheduler(const std::vector<size_t>& costs, int nbWorkers): queues((size_t) nbWorkers) {
+		std::vector<int> order(costs.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = (int) i;
+		std::stable_sort(order.begin(), order.end(), [&costs](int a, int b) { return costs[a] > costs[b]; });
+		for (size_t i = 0; i < order.size(); ++i)
+			queues[i % queues.size()].indices.push_back(order[i]);
+		for (WorkerQueue& queue : queues)
+			queue.tail = queue.indices.size();
+	}
+
+	// Get next item index to process for given worker. Return false if there is no more item.
+	bool next(int worker, int* index) {
+		return pop(worker, index) || steal(index);
+	}
+};
+
+#endif //VIDEORAPTOR_BATCHSCHEDULER_HPP
@@ -0,0 +1,158 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_ENCODEPIPELINE_HPP
+#define VIDEORAPTOR_ENCODEPIPELINE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ThumbnailOutput.hpp"
+
+// Scaled thumbnail waiting to be encoded and written.
+struct EncodeJob {
+	VideoThumbnail* videoThumbnail;
+	std::vector<unsigned char> pixels; // Tightly packed RGBA.
+	int width;
+	int height;
+	int64_t timestamp;
+};
+
+// Bounded queue between decoding workers and encoder threads, so that demuxing and decoding
+// of next videos overlap with compression and writing of previous thumbnails.
+// Decoding workers block when queue is full, encoder threads block when queue is empty.
+class EncodePipeline {
+	typedef std::chrono::steady_clock Clock;
+
+	std::deque<EncodeJob> jobs;
+	std::vector<EncodeJob> freeJobs; // Finished jobs kept to reuse their pixel buffers.
+	std::vector<std::thread> encoders;
+	size_t capacity;
+	VideoRaptorOptions encodeOptions;
+	ThumbnailPackWriter* pack;
+	bool closed;
+	std::mutex mutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	// Metrics, protected by mutex.
+	Clock::time_point start;
+	Clock::time_point decodeEnd; // Time when decoding workers ended, see endDecoding().
+	bool decodeEnded;
+	size_t maxDepth;
+	double depthSum; // Sum of queue depth seen by each push, including pushed job.
+	int64_t nbPushes;
+	double pushWaitTime; // Time spent by decoding workers waiting for room in queue, in seconds.
+	double encodeBusyTime; // Time spent by encoder threads encoding and writing, in seconds.
+	int nbFailed;
+
+	void runEncoder() {
+		while (true) {
+			EncodeJob job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				notEmpty.wait(lock, [this] { return closed || !jobs.empty(); });
+				if (jobs.empty())
+					return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+				notFull.notify_one();
+			}
+			Clock::time_point begin = Clock::now();
+			VideoReport* report = &job.videoThumbnail->report;
+			bool done = VideoReport_setDone(report, outputThumbnail(job.pixels.data(), job.width, job.height, job.timestamp,
+																	job.videoThumbnail, &encodeOptions, pack, report));
+			std::chrono::duration<double> elapsed = Clock::now() - begin;
+			std::lock_guard<std::mutex> lock(mutex);
+			encodeBusyTime += elapsed.count();
+			if (!done)
+				++nbFailed;
+			freeJobs.push_back(std::move(job));
+		}
+	}
+
+public:
+	// Queue size and number of encoders must be positive. Each encoder compresses with one thread.
+	EncodePipeline(size_t queueSize, int nbEncoders, const VideoRaptorOptions* options, ThumbnailPackWriter* sharedPack):
+			jobs(), freeJobs(), encoders(), capacity(queueSize), encodeOptions(*options), pack(sharedPack), closed(false),
+			mutex(), notEmpty(), notFull(), start(Clock::now()), decodeEnd(), decodeEnded(false), maxDepth(0), depthSum(0), nbPushes(0),
+			pushWaitTime(0), encodeBusyTime(0), nbFailed(0) {
+		encodeOptions.nbEncodeThreadsUsed = 1;
+		for (int i = 0; i < nbEncoders; ++i)
+			encoders.emplace_back(&EncodePipeline::runEncoder, this);
+	}
+
+	~EncodePipeline() {
+		close(nullptr);
+	}
+
+	// Queue a copy of given thumbnail image. Block while queue is full. Thread-safe.
+	void push(VideoThumbnail* videoThumbnail, const unsigned char* image, int width, int height, int64_t timestamp) {
+		EncodeJob job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!freeJobs.empty()) {
+				job = std::move(freeJobs.back());
+				freeJobs.pop_back();
+			}
+		}
+		// Copy outside lock.
+		job.videoThumbnail = videoThumbnail;
+		job.pixels.assign(image, image + (size_t) width * height * 4);
+		job.width = width;
+		job.height = height;
+		job.timestamp = timestamp;
+		Clock::time_point begin = Clock::now();
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [this] { return jobs.size() < capacity; });
+		std::chrono::duration<double> waited = Clock::now() - begin;
+		pushWaitTime += waited.count();
+		jobs.push_back(std::move(job));
+		maxDepth = std::max(maxDepth, jobs.size());
+		depthSum += jobs.size();
+		++nbPushes;
+		notEmpty.notify_one();
+	}
+
+	// Mark end of decoding stage, once decoding workers no longer push. Thread-safe.
+	// Decoding utilisation is measured until this time, so that draining queue is not counted.
+	void endDecoding() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!decodeEnded) {
+			decodeEnd = Clock::now();
+			decodeEnded = true;
+		}
+	}
+
+	// Wait until all queued thumbnails are written, stop encoder threads and, if options is not null,
+	// write pipeline metrics into it. Return number of thumbnails that could not be encoded or written.
+	int close(VideoRaptorOptions* options) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		notEmpty.notify_all();
+		endDecoding();
+		for (std::thread& encoder : encoders)
+			encoder.join();
+		std::chrono::duration<double> elapsed = Clock::now() - start;
+		std::chrono::duration<double> decodeElapsed = decodeEnd - start;
+		if (options && elapsed.count() > 0) {
+			options->encodeQueueMaxDepth = (int) maxDepth;
+			options->encodeQueueMeanDepth = nbPushes ? depthSum / nbPushes : 0;
+			options->decodeStageUtilisation = decodeElapsed.count() > 0
+											  ? 1 - pushWaitTime / (decodeElapsed.count() * options->nbWorkersUsed) : 0;
+			options->encodeStageUtilisation = encoders.empty() ? 0 : encodeBusyTime / (elapsed.count() * encoders.size());
+		}
+		encoders.clear();
+		int failed = nbFailed;
+		nbFailed = 0;
+		return failed;
+	}
+};
+
+#endif //VIDEORAPTOR_ENCODEPIPELINE_HPP
@@ -14,8 +14,13 @@ struct FileHandle {
 	FILE* file;
 	explicit FileHandle(const char* handledFileName = nullptr): filename(handledFileName), unicodeFilename(), file(nullptr) {}
 	~FileHandle() {
+		close();
+	}
+	void close() {
 		if (file)
 			fclose(file);
+		file = nullptr;
+		unicodeFilename.clear();
 	}
 };
 
@@ -0,0 +1,90 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_FRAMEPOOL_HPP
+#define VIDEORAPTOR_FRAMEPOOL_HPP
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+};
+#include <cstdint>
+#include <vector>
+
+// Frames and output buffers reused across thumbnails of one worker.
+// Buffers are allocated with a capacity rounded up to a power of two (geometry class),
+// so that a released buffer can serve any later request of same class or smaller.
+// Not thread-safe: one pool per worker.
+class FramePool {
+	struct Buffer {
+		uint8_t* data;
+		size_t capacity;
+	};
+	std::vector<AVFrame*> frames;
+	std::vector<Buffer> buffers;
+
+	static size_t getCapacityClass(size_t size) {
+		size_t capacity = 1;
+		while (capacity < size)
+			capacity <<= 1;
+		return capacity;
+	}
+
+public:
+	int64_t allocations; // Number of frames and buffers allocated by pool.
+
+	FramePool(): frames(), buffers(), allocations(0) {}
+	FramePool(const FramePool&) = delete;
+	FramePool& operator=(const FramePool&) = delete;
+
+	~FramePool() {
+		for (AVFrame* frame : frames)
+			av_frame_free(&frame);
+		for (Buffer& buffer : buffers)
+			av_free(buffer.data);
+	}
+
+	// Return an empty frame, or nullptr if allocation fails.
+	AVFrame* getFrame() {
+		if (!frames.empty()) {
+			AVFrame* frame = frames.back();
+			frames.pop_back();
+			return frame;
+		}
+		++allocations;
+		return av_frame_alloc();
+	}
+
+	// Give back a frame to pool. Frame data references are released.
+	void releaseFrame(AVFrame* frame) {
+		av_frame_unref(frame);
+		frames.push_back(frame);
+	}
+
+	// Return a buffer of at least given size, or nullptr if allocation fails.
+	// Actual buffer capacity is written into *capacity, and must be given back with releaseBuffer().
+	uint8_t* getBuffer(size_t size, size_t* capacity) {
+		// Use smallest free buffer big enough.
+		size_t found = buffers.size();
+		for (size_t i = 0; i < buffers.size(); ++i) {
+			if (buffers[i].capacity >= size && (found == buffers.size() || buffers[i].capacity < buffers[found].capacity))
+				found = i;
+		}
+		if (found < buffers.size()) {
+			Buffer buffer = buffers[found];
+			buffers.erase(buffers.begin() + found);
+			*capacity = buffer.capacity;
+			return buffer.data;
+		}
+		++allocations;
+		*capacity = getCapacityClass(size);
+		return (uint8_t*) av_malloc(*capacity);
+	}
+
+	void releaseBuffer(uint8_t* data, size_t capacity) {
+		buffers.push_back({data, capacity});
+	}
+};
+
+#endif //VIDEORAPTOR_FRAMEPOOL_HPP
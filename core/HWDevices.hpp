@@ -8,6 +8,8 @@
 extern "C" {
 #include <libavutil/hwcontext.h>
 };
+#include <atomic>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 #include <ostream>
@@ -15,9 +17,10 @@ extern "C" {
 struct HWDevices {
 	std::vector<AVHWDeviceType> available;
 	std::unordered_map<AVHWDeviceType, AVBufferRef*> loaded;
-	size_t indexUsed;
+	std::atomic<size_t> indexUsed;
+	std::mutex loadedMutex; // Protects `loaded`, as devices may be shared by many batch workers.
 
-	explicit HWDevices(): available(), loaded(), indexUsed(0) {
+	explicit HWDevices(): available(), loaded(), indexUsed(0), loadedMutex() {
 		AVHWDeviceType type = AV_HWDEVICE_TYPE_NONE;
 		while ((type = av_hwdevice_iterate_types(type)) != AV_HWDEVICE_TYPE_NONE) {
 			// I don't yet know why, but, if CUDA device is tested at a point and fails,
@@ -32,6 +35,20 @@ struct HWDevices {
 			av_buffer_unref(&it->second);
 	}
 
+	// Return a new reference to device context for given type, creating it on first call.
+	// Return nullptr if device context cannot be created. Safe to call from many threads.
+	AVBufferRef* getDeviceContext(AVHWDeviceType deviceType) {
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		auto it = loaded.find(deviceType);
+		if (it != loaded.end())
+			return av_buffer_ref(it->second);
+		AVBufferRef* hwDeviceCtx = nullptr;
+		if (av_hwdevice_ctx_create(&hwDeviceCtx, deviceType, NULL, NULL, 0) < 0)
+			return nullptr;
+		loaded[deviceType] = hwDeviceCtx;
+		return av_buffer_ref(hwDeviceCtx);
+	}
+
 	size_t countDeviceTypes() const {
 		return available.size();
 	}
@@ -0,0 +1,45 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_PNGPROFILE_HPP
+#define VIDEORAPTOR_PNGPROFILE_HPP
+
+#include <vector>
+#include <lib/lodepng/lodepng.h>
+
+enum VideoRaptorPngProfile {
+	PNG_PROFILE_BALANCED = 0,	// lodepng defaults: 2 KiB window, lazy matching, filter chosen per scanline.
+	PNG_PROFILE_FASTEST = 1,	// Small window, greedy short-chain matching, fixed Paeth filter. Bigger files.
+	PNG_PROFILE_SMALLEST = 2,	// Full 32 KiB window, longest matches, entropy filter heuristic. Much slower.
+};
+
+// PNG Paeth filter type, used for every scanline by fastest profile.
+#define PNG_FILTER_PAETH 4
+
+// Configure encoder state for given profile and image height.
+// Fixed filters are stored in given vector, which must outlive encoding.
+inline void configurePngProfile(lodepng::State& state, int profile, unsigned height, std::vector<unsigned char>& filters) {
+	LodePNGCompressSettings& zlib = state.encoder.zlibsettings;
+	switch (profile) {
+		case PNG_PROFILE_FASTEST:
+			zlib.windowsize = 1024;
+			zlib.nicematch = 32;
+			zlib.lazymatching = 0;
+			zlib.maxchainlength = 4;
+			filters.assign(height, PNG_FILTER_PAETH);
+			state.encoder.filter_strategy = LFS_PREDEFINED;
+			state.encoder.predefined_filters = filters.data();
+			break;
+		case PNG_PROFILE_SMALLEST:
+			zlib.windowsize = 32768;
+			zlib.nicematch = 258;
+			zlib.lazymatching = 1;
+			state.encoder.filter_strategy = LFS_ENTROPY;
+			break;
+		default:
+			break;
+	}
+}
+
+#endif //VIDEORAPTOR_PNGPROFILE_HPP
@@ -0,0 +1,101 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_QOIENCODER_HPP
+#define VIDEORAPTOR_QOIENCODER_HPP
+
+#include <cstring>
+#include <vector>
+
+// QOI ("Quite OK Image", https://qoiformat.org/) chunk tags.
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8
+#define QOI_MAX_RUN 62
+
+inline void qoiWrite32(unsigned char*& out, unsigned int value) {
+	*out++ = (unsigned char) (value >> 24);
+	*out++ = (unsigned char) (value >> 16);
+	*out++ = (unsigned char) (value >> 8);
+	*out++ = (unsigned char) value;
+}
+
+// Encode tightly packed RGBA pixels into QOI format (4 channels, sRGB).
+// Each pixel is encoded as a run of previous pixel, a reference to one of the 64 recently seen pixels,
+// a small difference from previous pixel, or literal values.
+inline void encodeQOI(std::vector<unsigned char>& out, const unsigned char* pixels, unsigned int width, unsigned int height) {
+	size_t nbPixels = (size_t) width * height;
+	// Worst case: one tag byte and 4 bytes for each pixel.
+	out.resize(QOI_HEADER_SIZE + nbPixels * 5 + QOI_PADDING_SIZE);
+	unsigned char* cursor = out.data();
+	unsigned char index[64][4];
+	unsigned char previous[4] = {0, 0, 0, 255};
+	int run = 0;
+	memset(index, 0, sizeof(index));
+
+	memcpy(cursor, "qoif", 4);
+	cursor += 4;
+	qoiWrite32(cursor, width);
+	qoiWrite32(cursor, height);
+	*cursor++ = 4; // channels
+	*cursor++ = 0; // sRGB with linear alpha
+
+	for (size_t i = 0; i < nbPixels; ++i) {
+		const unsigned char* pixel = pixels + i * 4;
+		if (memcmp(pixel, previous, 4) == 0) {
+			++run;
+			if (run == QOI_MAX_RUN || i == nbPixels - 1) {
+				*cursor++ = (unsigned char) (QOI_OP_RUN | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+		if (run) {
+			*cursor++ = (unsigned char) (QOI_OP_RUN | (run - 1));
+			run = 0;
+		}
+		int position = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+		if (memcmp(index[position], pixel, 4) == 0) {
+			*cursor++ = (unsigned char) (QOI_OP_INDEX | position);
+		} else {
+			memcpy(index[position], pixel, 4);
+			if (pixel[3] == previous[3]) {
+				signed char dr = (signed char) (pixel[0] - previous[0]);
+				signed char dg = (signed char) (pixel[1] - previous[1]);
+				signed char db = (signed char) (pixel[2] - previous[2]);
+				int drg = dr - dg;
+				int dbg = db - dg;
+				if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+					*cursor++ = (unsigned char) (QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+				} else if (drg > -9 && drg < 8 && dg > -33 && dg < 32 && dbg > -9 && dbg < 8) {
+					*cursor++ = (unsigned char) (QOI_OP_LUMA | (dg + 32));
+					*cursor++ = (unsigned char) ((drg + 8) << 4 | (dbg + 8));
+				} else {
+					*cursor++ = QOI_OP_RGB;
+					*cursor++ = pixel[0];
+					*cursor++ = pixel[1];
+					*cursor++ = pixel[2];
+				}
+			} else {
+				*cursor++ = QOI_OP_RGBA;
+				memcpy(cursor, pixel, 4);
+				cursor += 4;
+			}
+		}
+		memcpy(previous, pixel, 4);
+	}
+
+	// End marker: seven 0x00 bytes and one 0x01 byte.
+	memset(cursor, 0, QOI_PADDING_SIZE - 1);
+	cursor[QOI_PADDING_SIZE - 1] = 1;
+	cursor += QOI_PADDING_SIZE;
+	out.resize((size_t) (cursor - out.data()));
+}
+
+#endif //VIDEORAPTOR_QOIENCODER_HPP
@@ -0,0 +1,71 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_SCALERCACHE_HPP
+#define VIDEORAPTOR_SCALERCACHE_HPP
+
+extern "C" {
+#include <libswscale/swscale.h>
+};
+#include <cstdint>
+#include <vector>
+
+#define SCALER_CACHE_SIZE 8
+
+// Scaling contexts reused across frames and videos with same input and output geometry and format.
+// Least recently used context is freed when cache is full. Not thread-safe: one cache per worker.
+class ScalerCache {
+	struct Entry {
+		int srcWidth;
+		int srcHeight;
+		AVPixelFormat srcFormat;
+		int dstWidth;
+		int dstHeight;
+		AVPixelFormat dstFormat;
+		SwsContext* context;
+	};
+	std::vector<Entry> entries; // From least to most recently used.
+
+public:
+	int64_t hits;
+	int64_t misses;
+
+	ScalerCache(): entries(), hits(0), misses(0) {}
+	ScalerCache(const ScalerCache&) = delete;
+	ScalerCache& operator=(const ScalerCache&) = delete;
+
+	~ScalerCache() {
+		for (Entry& entry : entries)
+			sws_freeContext(entry.context);
+	}
+
+	// Return a scaling context owned by cache, or nullptr if context cannot be created.
+	SwsContext* get(int srcWidth, int srcHeight, AVPixelFormat srcFormat,
+					int dstWidth, int dstHeight, AVPixelFormat dstFormat) {
+		for (size_t i = 0; i < entries.size(); ++i) {
+			const Entry& entry = entries[i];
+			if (entry.srcWidth == srcWidth && entry.srcHeight == srcHeight && entry.srcFormat == srcFormat
+				&& entry.dstWidth == dstWidth && entry.dstHeight == dstHeight && entry.dstFormat == dstFormat) {
+				++hits;
+				Entry found = entry;
+				entries.erase(entries.begin() + i);
+				entries.push_back(found);
+				return found.context;
+			}
+		}
+		++misses;
+		SwsContext* context = sws_getContext(
+				srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat, SWS_BILINEAR, NULL, NULL, NULL);
+		if (!context)
+			return nullptr;
+		if (entries.size() == SCALER_CACHE_SIZE) {
+			sws_freeContext(entries.front().context);
+			entries.erase(entries.begin());
+		}
+		entries.push_back({srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat, context});
+		return context;
+	}
+};
+
+#endif //VIDEORAPTOR_SCALERCACHE_HPP
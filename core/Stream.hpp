@@ -11,6 +11,7 @@ extern "C" {
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
 }
+#include <algorithm>
 #include "HWDevices.hpp"
 #include "VideoInfo.hpp"
 
@@ -35,10 +36,17 @@ struct AudioStream: public Stream {
 		VideoReport_init(&report);
 	}
 
-	bool load(AVFormatContext* format) {
+	// Find best audio stream and its decoder, without opening decoder.
+	bool loadParameters(AVFormatContext* format) {
 		if ((index = av_find_best_stream(format, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0)) < 0)
 			return false;
 		stream = format->streams[index];
+		return true;
+	}
+
+	bool load(AVFormatContext* format) {
+		if (!loadParameters(format))
+			return false;
 		if (!(codecContext = avcodec_alloc_context3(codec)))
 			return VideoReport_error(&report, ERROR_ALLOC_CODEC_CONTEXT);
 		if (avcodec_parameters_to_context(codecContext, stream->codecpar) < 0)
@@ -49,6 +57,13 @@ struct AudioStream: public Stream {
 	}
 };
 
+// How video decoder is configured before it is opened.
+struct DecoderSettings {
+	int minimumSize; // If > 0 and codec supports it, decode at reduced resolution keeping larger side at least minimumSize.
+	int threadCount; // Number of decoding threads. 0 lets FFmpeg decide.
+	int threadType; // FF_THREAD_FRAME and/or FF_THREAD_SLICE.
+};
+
 struct VideoStream: public Stream {
 	const AVCodecHWConfig* selectedConfig;
 	VideoReport* report;
@@ -68,22 +83,24 @@ private:
 	}
 
 	bool loadHardwareDeviceContext(HWDevices& devices) {
-		if (devices.loaded.find(selectedConfig->device_type) != devices.loaded.end()) {
-			codecContext->hw_device_ctx = av_buffer_ref(devices.loaded[selectedConfig->device_type]);
-			return true;
-		}
-		AVBufferRef* hwDeviceCtx = nullptr;
-		if (av_hwdevice_ctx_create(&hwDeviceCtx, selectedConfig->device_type, NULL, NULL, 0) < 0) {
+		if (!(codecContext->hw_device_ctx = devices.getDeviceContext(selectedConfig->device_type)))
 			return VideoReport_error(report, ERROR_CREATE_HW_DEVICE_CONFIG);
-		}
-		devices.loaded[selectedConfig->device_type] = hwDeviceCtx;
-		codecContext->hw_device_ctx = av_buffer_ref(hwDeviceCtx);
 		// For more info about created device context,
 		// see av_hwdevice_get_type_name(selectedConfig->device_type)
 		// and av_pix_fmt_desc_get(selectedConfig->pix_fmt)->name.
 		return true;
 	}
 
+	// Return largest lowres factor supported by codec such that
+	// larger side of decoded frames is still at least minimumSize.
+	int chooseLowres(int minimumSize) const {
+		int largerSide = std::max(stream->codecpar->width, stream->codecpar->height);
+		int lowres = 0;
+		while (lowres < codec->max_lowres && ((largerSide + (1 << (lowres + 1)) - 1) >> (lowres + 1)) >= minimumSize)
+			++lowres;
+		return lowres;
+	}
+
 	static AVPixelFormat get_hw_format(AVCodecContext* ctx, const AVPixelFormat* pix_fmts) {
 		auto streamInfo = (VideoStream*) ctx->opaque;
 		if (streamInfo->selectedConfig) {
@@ -100,7 +117,22 @@ public:
 
 	explicit VideoStream(VideoReport* videoReport): Stream(), selectedConfig(nullptr), report(videoReport) {}
 
-	bool load(AVFormatContext* format, HWDevices& devices, size_t deviceIndex) {
+	// Find best video stream and its decoder, and check stream parameters, without opening decoder.
+	bool loadParameters(AVFormatContext* format) {
+		if ((index = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)) < 0)
+			return VideoReport_error(report, ERROR_FIND_VIDEO_STREAM);
+		stream = format->streams[index];
+		if (stream->codecpar->format == AV_PIX_FMT_NONE)
+			return VideoReport_error(report, ERROR_INVALID_PIX_FMT);
+		if (stream->codecpar->width <= 0)
+			return VideoReport_error(report, ERROR_INVALID_WIDTH);
+		if (stream->codecpar->height <= 0)
+			return VideoReport_error(report, ERROR_INVALID_HEIGHT);
+		return true;
+	}
+
+	// Reduced resolution from settings is not used with hardware decoding.
+	bool load(AVFormatContext* format, HWDevices& devices, size_t deviceIndex, const DecoderSettings& settings) {
 		if ((index = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)) < 0)
 			return VideoReport_error(report, ERROR_FIND_VIDEO_STREAM);
 		stream = format->streams[index];
@@ -113,6 +145,11 @@ public:
 		if (avcodec_parameters_to_context(codecContext, stream->codecpar) < 0)
 			return VideoReport_error(report, ERROR_CONVERT_CODEC_PARAMS);
 
+		if (settings.minimumSize > 0 && !selectedConfig)
+			codecContext->lowres = chooseLowres(settings.minimumSize);
+		codecContext->thread_count = settings.threadCount;
+		codecContext->thread_type = settings.threadType;
+
 		if (selectedConfig) {
 			codecContext->opaque = this;
 			codecContext->get_format = get_hw_format;
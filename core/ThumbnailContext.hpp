@@ -9,33 +9,36 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
 };
+#include "WorkerResources.hpp"
 
+// Frames and buffer are borrowed from worker resources, and given back on destruction.
 struct ThumbnailContext {
 	AVFrame* tmpFrame; // either frame or swFrame.
 	AVFrame* frame;
 	AVFrame* swFrame;
 	AVFrame* frameRGB;
 	uint8_t* buffer;
-	SwsContext* swsContext;
+	size_t bufferCapacity;
+	SwsContext* swsContext; // Owned by worker resources.
 	AVPacket packet;
 	bool packetIsUsed;
+	WorkerResources& resources;
 
-	ThumbnailContext(): tmpFrame(nullptr), frame(nullptr), swFrame(nullptr), frameRGB(nullptr), buffer(nullptr),
-						swsContext(nullptr), packet(), packetIsUsed(false) {}
+	explicit ThumbnailContext(WorkerResources& workerResources):
+			tmpFrame(nullptr), frame(nullptr), swFrame(nullptr), frameRGB(nullptr), buffer(nullptr), bufferCapacity(0),
+			swsContext(nullptr), packet(), packetIsUsed(false), resources(workerResources) {}
 
 	~ThumbnailContext() {
 		if (packetIsUsed)
 			av_packet_unref(&packet);
 		if (frame)
-			av_frame_free(&frame);
+			resources.frames.releaseFrame(frame);
 		if (swFrame)
-			av_frame_free(&swFrame);
+			resources.frames.releaseFrame(swFrame);
 		if (frameRGB)
-			av_frame_free(&frameRGB);
+			resources.frames.releaseFrame(frameRGB);
 		if (buffer)
-			av_freep(&buffer);
-		if (swsContext)
-			sws_freeContext(swsContext);
+			resources.frames.releaseBuffer(buffer, bufferCapacity);
 	}
 
 };
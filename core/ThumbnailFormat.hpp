@@ -0,0 +1,25 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_THUMBNAILFORMAT_HPP
+#define VIDEORAPTOR_THUMBNAILFORMAT_HPP
+
+enum VideoRaptorThumbnailFormat {
+	THUMBNAIL_FORMAT_PNG = 0,	// Default. Compressed with deflate, readable everywhere.
+	THUMBNAIL_FORMAT_QOI = 1,	// "Quite OK Image" format. Much faster to encode and decode, files are bigger.
+};
+
+// Return file extension for given thumbnail format, or null if format is unknown.
+inline const char* getThumbnailExtension(int format) {
+	switch (format) {
+		case THUMBNAIL_FORMAT_PNG:
+			return ".png";
+		case THUMBNAIL_FORMAT_QOI:
+			return ".qoi";
+		default:
+			return nullptr;
+	}
+}
+
+#endif //VIDEORAPTOR_THUMBNAILFORMAT_HPP
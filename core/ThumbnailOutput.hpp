@@ -0,0 +1,97 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_THUMBNAILOUTPUT_HPP
+#define VIDEORAPTOR_THUMBNAILOUTPUT_HPP
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <lib/lodepng/lodepng.h>
+#include "utils.hpp"
+#include "PngProfile.hpp"
+#include "QoiEncoder.hpp"
+#include "ThumbnailFormat.hpp"
+#include "ThumbnailPack.hpp"
+#include "VideoRaptorOptions.hpp"
+#include "VideoReport.hpp"
+#include "VideoThumbnail.hpp"
+
+// Encoding and writing of scaled RGBA images. Functions do not depend on a loaded video,
+// so they can run either on decoding worker or on a separate encoder thread.
+
+inline std::string generateThumbnailPath(const char* thFolder, const char* thName, const char* extension = ".png") {
+	std::string thumbnailPath = thFolder;
+	if (!thumbnailPath.empty()) {
+		char lastChar = thumbnailPath[thumbnailPath.size() - 1];
+		if (lastChar != SEPARATOR && lastChar != OTHER_SEPARATOR)
+			thumbnailPath.push_back(SEPARATOR);
+	}
+	thumbnailPath += thName;
+	thumbnailPath += extension;
+	for (char& character: thumbnailPath)
+		if (character == OTHER_SEPARATOR)
+			character = SEPARATOR;
+	return thumbnailPath;
+}
+
+inline bool encodePNG(std::vector<unsigned char>& png, const unsigned char* image, int width, int height,
+					  const VideoRaptorOptions* options, VideoReport* report) {
+	lodepng::State state;
+	std::vector<unsigned char> filters;
+	configurePngProfile(state, options->pngProfile, (unsigned int) height, filters);
+	state.encoder.zlibsettings.numthreads = (unsigned int) options->nbEncodeThreadsUsed;
+	unsigned ret = lodepng::encode(png, image, (unsigned int) width, (unsigned int) height, state);
+	if (ret)
+		return VideoReport_error(report, ERROR_PNG_ENCODER, lodepng_error_text(ret));
+	return true;
+}
+
+// Encode tightly packed RGBA pixels with given thumbnail format (see VideoRaptorThumbnailFormat).
+inline bool encodeImage(std::vector<unsigned char>& encoded, const unsigned char* image, int width, int height,
+						int format, const VideoRaptorOptions* options, VideoReport* report) {
+	if (!getThumbnailExtension(format))
+		return VideoReport_error(report, ERROR_SAVE_THUMBNAIL, "Unknown thumbnail format.");
+	if (format == THUMBNAIL_FORMAT_QOI) {
+		encodeQOI(encoded, image, (unsigned int) width, (unsigned int) height);
+		return true;
+	}
+	return encodePNG(encoded, image, width, height, options, report);
+}
+
+// Write encoded image into <thFolder>/<thName> with extension of given format.
+inline bool writeImage(const std::vector<unsigned char>& encoded, const char* thFolder, const char* thName, int format,
+					   VideoReport* report) {
+	unsigned ret = lodepng::save_file(encoded, generateThumbnailPath(thFolder, thName, getThumbnailExtension(format)));
+	if (ret)
+		return VideoReport_error(report, ERROR_SAVE_THUMBNAIL, lodepng_error_text(ret));
+	return true;
+}
+
+// Encode thumbnail image and deliver it as requested by videoThumbnail and options:
+// returned in memory, appended to pack (if not null), or saved as a file.
+// Timestamp is frame time in AV_TIME_BASE units, stored in pack index.
+inline bool outputThumbnail(const unsigned char* image, int width, int height, int64_t timestamp,
+							VideoThumbnail* videoThumbnail, const VideoRaptorOptions* options,
+							ThumbnailPackWriter* pack, VideoReport* report) {
+	std::vector<unsigned char> encoded;
+	if (!encodeImage(encoded, image, width, height, videoThumbnail->format, options, report))
+		return false;
+	if (videoThumbnail->inMemory) {
+		delete[] videoThumbnail->data;
+		videoThumbnail->data = new unsigned char[encoded.size()];
+		videoThumbnail->dataSize = encoded.size();
+		memcpy(videoThumbnail->data, encoded.data(), encoded.size());
+		return true;
+	}
+	if (pack) {
+		if (!pack->append(videoThumbnail->filename, encoded, timestamp, width, height, videoThumbnail->format, report))
+			return VideoReport_error(report, ERROR_SAVE_THUMBNAIL, "Unable to write thumbnail pack.");
+		return true;
+	}
+	return writeImage(encoded, videoThumbnail->thumbnailFolder, videoThumbnail->thumbnailName,
+					  videoThumbnail->format, report);
+}
+
+#endif //VIDEORAPTOR_THUMBNAILOUTPUT_HPP
@@ -0,0 +1,320 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_THUMBNAILPACK_HPP
+#define VIDEORAPTOR_THUMBNAILPACK_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "VideoReport.hpp"
+
+/* A thumbnail pack is made of two append-only files:
+ * - <pack>: magic string, then encoded thumbnails one after the other.
+ * - <pack>.index: magic string, then one record per thumbnail (little-endian):
+ *   offset (u64), size (u64), timestamp (i64, AV_TIME_BASE units), width (u32), height (u32),
+ *   format (u32, see VideoRaptorThumbnailFormat), video filename length (u32), video filename (UTF-8, no null byte).
+ * A video may appear many times: latest record wins.
+ * Records left incomplete by an interrupted run are dropped when pack is opened for appending. */
+#define THUMBNAIL_PACK_MAGIC "VRPACK01"
+#define THUMBNAIL_PACK_INDEX_MAGIC "VRINDX01"
+#define THUMBNAIL_PACK_MAGIC_SIZE 8
+#define THUMBNAIL_PACK_RECORD_SIZE 40
+#define THUMBNAIL_PACK_INDEX_EXTENSION ".index"
+// Thumbnails are written once buffered data reaches this size.
+#define THUMBNAIL_PACK_BUFFER_SIZE (8 << 20)
+
+struct ThumbnailPackEntry {
+	std::string filename;
+	uint64_t offset;
+	uint64_t size;
+	int64_t timestamp;
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+};
+
+inline bool packSeekEnd(FILE* file, uint64_t* size) {
+#ifdef WIN32
+	if (_fseeki64(file, 0, SEEK_END) != 0)
+		return false;
+	int64_t position = _ftelli64(file);
+#else
+	if (fseeko(file, 0, SEEK_END) != 0)
+		return false;
+	int64_t position = ftello(file);
+#endif
+	if (position < 0)
+		return false;
+	*size = (uint64_t) position;
+	return true;
+}
+
+inline bool packSeek(FILE* file, uint64_t offset) {
+#ifdef WIN32
+	return _fseeki64(file, (int64_t) offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+#endif
+}
+
+inline void packWrite(std::vector<unsigned char>& buffer, uint64_t value, int nbBytes) {
+	for (int i = 0; i < nbBytes; ++i)
+		buffer.push_back((unsigned char) (value >> (8 * i)));
+}
+
+inline uint64_t packRead(const unsigned char* data, int nbBytes) {
+	uint64_t value = 0;
+	for (int i = 0; i < nbBytes; ++i)
+		value |= (uint64_t) data[i] << (8 * i);
+	return value;
+}
+
+inline bool packReadFile(const std::string& filename, std::vector<unsigned char>& data) {
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+	unsigned char chunk[65536];
+	size_t count;
+	while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		data.insert(data.end(), chunk, chunk + count);
+	fclose(file);
+	return true;
+}
+
+// Parse index records following magic string, into entries if not null.
+// Parsing stops at first incomplete record (e.g. interrupted run), including a record whose
+// thumbnail goes beyond pack size. Return size of index up to last complete record.
+inline size_t packParseIndex(const std::vector<unsigned char>& index, uint64_t packSize,
+							 std::vector<ThumbnailPackEntry>* entries) {
+	size_t position = THUMBNAIL_PACK_MAGIC_SIZE;
+	while (position + THUMBNAIL_PACK_RECORD_SIZE <= index.size()) {
+		const unsigned char* record = index.data() + position;
+		size_t filenameLength = (size_t) packRead(record + 36, 4);
+		if (filenameLength > index.size() - position - THUMBNAIL_PACK_RECORD_SIZE)
+			break;
+		ThumbnailPackEntry entry;
+		entry.offset = packRead(record, 8);
+		entry.size = packRead(record + 8, 8);
+		if (entry.offset < THUMBNAIL_PACK_MAGIC_SIZE || entry.offset > packSize || entry.size > packSize - entry.offset)
+			break;
+		if (entries) {
+			entry.timestamp = (int64_t) packRead(record + 16, 8);
+			entry.width = (uint32_t) packRead(record + 24, 4);
+			entry.height = (uint32_t) packRead(record + 28, 4);
+			entry.format = (uint32_t) packRead(record + 32, 4);
+			entry.filename.assign((const char*) record + THUMBNAIL_PACK_RECORD_SIZE, filenameLength);
+			entries->push_back(entry);
+		}
+		position += THUMBNAIL_PACK_RECORD_SIZE + filenameLength;
+	}
+	return position;
+}
+
+// Truncate index to its last complete record, so that records appended by next runs stay reachable.
+// Return false if index exists but is not a thumbnail pack index, or cannot be repaired.
+inline bool packRepairIndex(const std::string& indexFilename, uint64_t packSize) {
+	std::vector<unsigned char> index;
+	if (!packReadFile(indexFilename, index))
+		return true;
+	size_t validSize;
+	if (index.size() < THUMBNAIL_PACK_MAGIC_SIZE) {
+		// Magic string itself was interrupted: index is restarted.
+		if (!index.empty() && memcmp(index.data(), THUMBNAIL_PACK_INDEX_MAGIC, index.size()) != 0)
+			return false;
+		validSize = 0;
+	} else {
+		if (memcmp(index.data(), THUMBNAIL_PACK_INDEX_MAGIC, THUMBNAIL_PACK_MAGIC_SIZE) != 0)
+			return false;
+		validSize = packParseIndex(index, packSize, nullptr);
+	}
+	if (validSize == index.size())
+		return true;
+	FILE* file = fopen(indexFilename.c_str(), "wb");
+	if (!file)
+		return false;
+	bool written = fwrite(index.data(), 1, validSize, file) == validSize;
+	return fclose(file) == 0 && written;
+}
+
+// Open pack file and its index for appending. Write magic strings if files are new.
+inline FILE* packOpen(const std::string& filename, const char* magic, uint64_t* size) {
+	FILE* file = fopen(filename.c_str(), "ab");
+	if (!file)
+		return nullptr;
+	if (!packSeekEnd(file, size)
+		|| (*size == 0 && fwrite(magic, 1, THUMBNAIL_PACK_MAGIC_SIZE, file) != THUMBNAIL_PACK_MAGIC_SIZE)) {
+		fclose(file);
+		return nullptr;
+	}
+	if (*size == 0)
+		*size = THUMBNAIL_PACK_MAGIC_SIZE;
+	return file;
+}
+
+// Append thumbnails from many workers into one pack. Thumbnails are buffered and written
+// in big sequential writes: pack data first, then index records, so that index never refers to missing data.
+class ThumbnailPackWriter {
+	FILE* packFile;
+	FILE* indexFile;
+	uint64_t packSize; // Size of pack file including buffered data, i.e. offset of next thumbnail.
+	std::vector<unsigned char> packBuffer;
+	std::vector<unsigned char> indexBuffer;
+	std::vector<VideoReport*> pendingReports; // Reports of buffered thumbnails.
+	std::vector<VideoReport*> failedReports; // Reports of thumbnails that could not be written.
+	bool failed;
+	std::mutex mutex;
+
+	// Must be called with mutex locked.
+	bool flush() {
+		if (!failed && !packBuffer.empty()
+			&& (fwrite(packBuffer.data(), 1, packBuffer.size(), packFile) != packBuffer.size()
+				|| fflush(packFile) != 0
+				|| fwrite(indexBuffer.data(), 1, indexBuffer.size(), indexFile) != indexBuffer.size()
+				|| fflush(indexFile) != 0))
+			failed = true;
+		if (failed)
+			failedReports.insert(failedReports.end(), pendingReports.begin(), pendingReports.end());
+		pendingReports.clear();
+		packBuffer.clear();
+		indexBuffer.clear();
+		return !failed;
+	}
+
+public:
+	explicit ThumbnailPackWriter(const char* packFilename):
+			packFile(nullptr), indexFile(nullptr), packSize(0), packBuffer(), indexBuffer(),
+			pendingReports(), failedReports(), failed(false), mutex() {
+		uint64_t indexSize = 0;
+		std::string filename = packFilename;
+		std::string indexFilename = filename + THUMBNAIL_PACK_INDEX_EXTENSION;
+		packFile = packOpen(filename, THUMBNAIL_PACK_MAGIC, &packSize);
+		if (packFile && packRepairIndex(indexFilename, packSize))
+			indexFile = packOpen(indexFilename, THUMBNAIL_PACK_INDEX_MAGIC, &indexSize);
+		failed = !packFile || !indexFile;
+		packBuffer.reserve(THUMBNAIL_PACK_BUFFER_SIZE);
+	}
+
+	~ThumbnailPackWriter() {
+		close();
+	}
+
+	// Add encoded thumbnail of given video. Thread-safe.
+	// Return false if pack could not be opened or written. Report is kept to be marked failed
+	// by close() if this thumbnail cannot be written later.
+	bool append(const char* videoFilename, const std::vector<unsigned char>& data, int64_t timestamp,
+				int width, int height, int format, VideoReport* report) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (failed)
+			return false;
+		size_t filenameLength = strlen(videoFilename);
+		packWrite(indexBuffer, packSize, 8);
+		packWrite(indexBuffer, data.size(), 8);
+		packWrite(indexBuffer, (uint64_t) timestamp, 8);
+		packWrite(indexBuffer, (uint32_t) width, 4);
+		packWrite(indexBuffer, (uint32_t) height, 4);
+		packWrite(indexBuffer, (uint32_t) format, 4);
+		packWrite(indexBuffer, filenameLength, 4);
+		indexBuffer.insert(indexBuffer.end(), videoFilename, videoFilename + filenameLength);
+		packBuffer.insert(packBuffer.end(), data.begin(), data.end());
+		packSize += data.size();
+		pendingReports.push_back(report);
+		if (packBuffer.size() < THUMBNAIL_PACK_BUFFER_SIZE || flush())
+			return true;
+		// Caller reports its own failure.
+		failedReports.pop_back();
+		return false;
+	}
+
+	// Write buffered thumbnails and close files. Must not be called while workers append.
+	// Reports of thumbnails that could not be written are marked as failed.
+	// Return number of such thumbnails.
+	int close() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (packFile || indexFile)
+			flush();
+		if (packFile && fclose(packFile) != 0)
+			failed = true;
+		if (indexFile && fclose(indexFile) != 0)
+			failed = true;
+		packFile = indexFile = nullptr;
+		for (VideoReport* report : failedReports) {
+			VideoReport_setDone(report, false);
+			VideoReport_error(report, ERROR_SAVE_THUMBNAIL, "Unable to write thumbnail pack.");
+		}
+		int nbFailed = (int) failedReports.size();
+		failedReports.clear();
+		return nbFailed;
+	}
+};
+
+// Read thumbnails from a pack. Whole index is loaded on open.
+class ThumbnailPackReader {
+	FILE* packFile;
+	std::vector<ThumbnailPackEntry> entries;
+	std::unordered_map<std::string, size_t> latest; // Video filename to index of its latest entry.
+
+	bool loadIndex(const std::string& indexFilename, uint64_t packSize) {
+		std::vector<unsigned char> index;
+		if (!packReadFile(indexFilename, index) || index.size() < THUMBNAIL_PACK_MAGIC_SIZE
+			|| memcmp(index.data(), THUMBNAIL_PACK_INDEX_MAGIC, THUMBNAIL_PACK_MAGIC_SIZE) != 0)
+			return false;
+		packParseIndex(index, packSize, &entries);
+		for (size_t i = 0; i < entries.size(); ++i)
+			latest[entries[i].filename] = i;
+		return true;
+	}
+
+public:
+	explicit ThumbnailPackReader(const char* packFilename): packFile(nullptr), entries(), latest() {
+		std::string filename = packFilename;
+		unsigned char magic[THUMBNAIL_PACK_MAGIC_SIZE];
+		uint64_t packSize = 0;
+		packFile = fopen(filename.c_str(), "rb");
+		if (packFile && (fread(magic, 1, THUMBNAIL_PACK_MAGIC_SIZE, packFile) != THUMBNAIL_PACK_MAGIC_SIZE
+						 || memcmp(magic, THUMBNAIL_PACK_MAGIC, THUMBNAIL_PACK_MAGIC_SIZE) != 0
+						 || !packSeekEnd(packFile, &packSize)
+						 || !loadIndex(filename + THUMBNAIL_PACK_INDEX_EXTENSION, packSize))) {
+			fclose(packFile);
+			packFile = nullptr;
+		}
+	}
+
+	~ThumbnailPackReader() {
+		if (packFile)
+			fclose(packFile);
+	}
+
+	ThumbnailPackReader(const ThumbnailPackReader&) = delete;
+	ThumbnailPackReader& operator=(const ThumbnailPackReader&) = delete;
+
+	bool isOpen() const {
+		return packFile != nullptr;
+	}
+
+	// All entries, in writing order.
+	const std::vector<ThumbnailPackEntry>& getEntries() const {
+		return entries;
+	}
+
+	// Return latest entry for given video, or null if video has no thumbnail in pack.
+	const ThumbnailPackEntry* find(const char* videoFilename) const {
+		auto iterator = latest.find(videoFilename);
+		return iterator == latest.end() ? nullptr : &entries[iterator->second];
+	}
+
+	// Read encoded thumbnail of given entry. Not thread-safe.
+	bool read(const ThumbnailPackEntry& entry, std::vector<unsigned char>& data) {
+		if (!packFile || !packSeek(packFile, entry.offset))
+			return false;
+		data.resize((size_t) entry.size);
+		return fread(data.data(), 1, data.size(), packFile) == data.size();
+	}
+};
+
+#endif //VIDEORAPTOR_THUMBNAILPACK_HPP
@@ -0,0 +1,22 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_THUMBNAILPACKRECORD_HPP
+#define VIDEORAPTOR_THUMBNAILPACKRECORD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Thumbnail stored in a thumbnail pack, as given by ThumbnailPack_find() or ThumbnailPack_getRecord().
+struct ThumbnailPackRecord {
+	const char* filename; // Video filename. Owned by pack, valid until ThumbnailPack_close().
+	uint64_t offset; // Position of encoded thumbnail in pack file.
+	size_t dataSize; // Size of encoded thumbnail.
+	int64_t timestamp; // Frame time in AV_TIME_BASE units.
+	int width;
+	int height;
+	int format; // See VideoRaptorThumbnailFormat.
+};
+
+#endif //VIDEORAPTOR_THUMBNAILPACKRECORD_HPP
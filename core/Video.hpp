@@ -10,6 +10,9 @@ extern "C" {
 #include <libavutil/imgutils.h>
 };
 #include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
 #include <sys/stat.h>
 #include <lib/lodepng/lodepng.h>
 #include "utils.hpp"
@@ -18,12 +21,17 @@ extern "C" {
 #include "ThumbnailContext.hpp"
 #include "VideoInfo.hpp"
 #include "VideoThumbnail.hpp"
+#include "VideoFrames.hpp"
 #include "FileHandle.hpp"
+#include "VideoRaptorOptions.hpp"
+#include "ThumbnailFormat.hpp"
+#include "ThumbnailOutput.hpp"
 #ifdef WIN32
 #include "compatWindows.hpp"
 #endif
 
 #define THUMBNAIL_SIZE 300
+#define PROBE_RETRY_FACTOR 10
 
 class Video {
 	FileHandle fileHandle;
@@ -32,6 +40,8 @@ class Video {
 	AudioStream audioStream;
 	VideoStream videoStream;
 	VideoReport* report;
+	bool probeRetried;
+	int64_t sentPackets;
 
 	bool loadInputFile() {
 #ifdef WIN32
@@ -45,164 +55,374 @@ class Video {
 #endif
 	}
 
-	bool load(HWDevices& devices, size_t deviceIndex) {
+	bool load(HWDevices& devices, size_t deviceIndex, const VideoRaptorOptions* options) {
 		// Open video file.
 		if (!loadInputFile())
 			return false;
 		// Retrieve stream information.
 		if (avformat_find_stream_info(format, NULL) < 0)
 			return VideoReport_error(report, ERROR_NO_STREAM_INFO);
+		DecoderSettings settings;
+		settings.minimumSize = options->lowresThumbnails ? THUMBNAIL_SIZE : 0;
+		settings.threadCount = options->nbDecodeThreadsUsed;
+		settings.threadType = options->decodeThreadType;
 		// Load best audio and video streams.
-		if (!videoStream.load(format, devices, deviceIndex))
+		if (!videoStream.load(format, devices, deviceIndex, settings))
 			return false;
 		// Audio stream loading is optional.
 		audioStream.load(format);
 		return true;
 	}
 
-	static std::string generateThumbnailPath(const char* thFolder, const char* thName) {
-		std::string thumbnailPath = thFolder;
-		if (!thumbnailPath.empty()) {
-			char lastChar = thumbnailPath[thumbnailPath.size() - 1];
-			if (lastChar != SEPARATOR && lastChar != OTHER_SEPARATOR)
-				thumbnailPath.push_back(SEPARATOR);
+	void closeInputFile() {
+		if (format) {
+			avformat_close_input(&format);
+		}
+		if (avioContext) {
+			av_freep(&avioContext->buffer);
+			avio_context_free(&avioContext);
+		}
+		fileHandle.close();
+	}
+
+	bool findStreamInfo(int64_t probeSize, int64_t analyzeDuration) {
+		if (probeSize > 0)
+			format->probesize = probeSize;
+		if (analyzeDuration > 0)
+			format->max_analyze_duration = analyzeDuration;
+		if (avformat_find_stream_info(format, NULL) < 0)
+			return VideoReport_error(report, ERROR_NO_STREAM_INFO);
+		return true;
+	}
+
+	// Check if best video stream has all fields required by extractInfo().
+	bool hasRequiredStreamInfo() const {
+		int index = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+		if (index < 0)
+			return false;
+		const AVStream* stream = format->streams[index];
+		return stream->codecpar->width > 0
+			   && stream->codecpar->height > 0
+			   && stream->codecpar->format != AV_PIX_FMT_NONE
+			   && (stream->avg_frame_rate.den || stream->r_frame_rate.den);
+	}
+
+	// Load only what is needed to extract video info: no decoder is opened and no hardware device is used.
+	bool loadMetadata(const VideoRaptorOptions* options) {
+		if (!loadInputFile())
+			return false;
+		if (!findStreamInfo(options->probeSize, options->analyzeDuration))
+			return false;
+		if (options->adaptiveProbing
+			&& (options->probeSize > 0 || options->analyzeDuration > 0)
+			&& !hasRequiredStreamInfo()) {
+			// Probe budget was too small: reopen file and probe again with a bigger budget.
+			probeRetried = true;
+			closeInputFile();
+			if (!loadInputFile())
+				return false;
+			if (!findStreamInfo(options->probeSize * PROBE_RETRY_FACTOR, options->analyzeDuration * PROBE_RETRY_FACTOR))
+				return false;
+		}
+		if (!videoStream.loadParameters(format))
+			return false;
+		audioStream.loadParameters(format);
+		return true;
+	}
+
+	// Get video size, reduced if necessary to fit in a square of maxSize.
+	// Computed from full video size, as frames may be decoded at reduced resolution.
+	void getThumbnailSize(int* outputWidth, int* outputHeight, int maxSize = THUMBNAIL_SIZE) const {
+		int width = videoStream.stream->codecpar->width;
+		int height = videoStream.stream->codecpar->height;
+		if (width > maxSize || height > maxSize) {
+			if (width > height) {
+				height = maxSize * height / width;
+				width = maxSize;
+			} else if (width < height) {
+				width = maxSize * width / height;
+				height = maxSize;
+			} else {
+				width = height = maxSize;
+			}
+		}
+		*outputWidth = std::max(width, 1);
+		*outputHeight = std::max(height, 1);
+	}
+
+	void setKeyframeDecoding(const VideoRaptorOptions* options) {
+		// Backward seek moves to a keyframe at or before target.
+		// In keyframe mode, decoder then skips everything but keyframes.
+		if (options->keyframeThumbnails)
+			videoStream.codecContext->skip_frame = AVDISCARD_NONKEY;
+	}
+
+	// Seek to given timestamp (in AV_TIME_BASE units) and decode first available frame.
+	// Decoded frame (transferred from GPU if necessary) is then available in thCtx.tmpFrame.
+	bool decodeFrameAt(ThumbnailContext& thCtx, int64_t timestamp, const VideoRaptorOptions* options) {
+		// Drop frames buffered in decoder from a previous seek.
+		avcodec_flush_buffers(videoStream.codecContext);
+
+		// seek
+		if (av_seek_frame(format, -1, timestamp, AVSEEK_FLAG_BACKWARD) < 0)
+			return VideoReport_error(report, ERROR_SEEK_VIDEO);
+
+		// Allocate video frame
+		if (!thCtx.frame && !(thCtx.frame = thCtx.resources.frames.getFrame()))
+			return VideoReport_error(report, ERROR_ALLOC_INPUT_FRAME);
+
+		// Read packets until decoder outputs a frame.
+		bool endOfFile = false;
+		while (true) {
+			if (!endOfFile) {
+				if (av_read_frame(format, &thCtx.packet) < 0) {
+					// No more packets: flush decoder to get frames it may still hold.
+					endOfFile = true;
+					avcodec_send_packet(videoStream.codecContext, NULL);
+				} else {
+					// Is this a packet from the video stream?
+					bool isVideoPacket = thCtx.packet.stream_index == videoStream.index;
+					int ret = isVideoPacket ? avcodec_send_packet(videoStream.codecContext, &thCtx.packet) : 0;
+					av_packet_unref(&thCtx.packet);
+					if (!isVideoPacket)
+						continue;
+					if (ret < 0)
+						return VideoReport_error(report, ERROR_SEND_PACKET);
+					++sentPackets;
+				}
+			}
+			// Receive frame.
+			int ret = avcodec_receive_frame(videoStream.codecContext, thCtx.frame);
+			if (endOfFile && (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF))
+				return VideoReport_error(report, ERROR_SAVE_THUMBNAIL);
+			if (ret == AVERROR(EAGAIN))
+				continue;
+			if (ret < 0)
+				return VideoReport_error(report, ERROR_DECODE_VIDEO);
+			if (options->keyframeThumbnails && !thCtx.frame->key_frame)
+				continue;
+			break;
+		}
+
+		// Set frame to save (either from decoded frame or from GPU).
+		if (videoStream.selectedConfig && thCtx.frame->format == videoStream.selectedConfig->pix_fmt) {
+			// Allocate HW video frame
+			if (!thCtx.swFrame && !(thCtx.swFrame = thCtx.resources.frames.getFrame()))
+				return VideoReport_error(report, ERROR_ALLOC_HW_INPUT_FRAME);
+			av_frame_unref(thCtx.swFrame);
+			// retrieve data from GPU to CPU
+			if (av_hwframe_transfer_data(thCtx.swFrame, thCtx.frame, 0) < 0)
+				return VideoReport_error(report, ERROR_HW_DATA_TRANSFER);
+			thCtx.tmpFrame = thCtx.swFrame;
+		} else {
+			thCtx.tmpFrame = thCtx.frame;
 		}
-		thumbnailPath += thName;
-		thumbnailPath += ".png";
-		for (char& character: thumbnailPath)
-			if (character == OTHER_SEPARATOR)
-				character = SEPARATOR;
-		return thumbnailPath;
+		return true;
 	}
 
-	bool savePNG(AVFrame* pFrame, const char* thFolder, const char* thName) {
-		std::vector<unsigned char> image((size_t) (pFrame->width * pFrame->height * 4));
+	// Convert thCtx.tmpFrame to PIXEL_FMT with given output size, into thCtx.frameRGB.
+	// Output frame is allocated on first call, then reused.
+	// Output rows are tightly packed (no line padding), so that encoder can read output frame directly.
+	bool scaleFrame(ThumbnailContext& thCtx, int outputWidth, int outputHeight) {
+		int align = 1;
+		if (!thCtx.frameRGB) {
+			// Allocate an AVFrame structure
+			thCtx.frameRGB = thCtx.resources.frames.getFrame();
+			if (thCtx.frameRGB == NULL)
+				return VideoReport_error(report, ERROR_ALLOC_OUTPUT_FRAME);
+
+			// Determine required buffer size and allocate buffer
+			int numBytes = av_image_get_buffer_size(PIXEL_FMT, outputWidth, outputHeight, align);
+			thCtx.buffer = thCtx.resources.frames.getBuffer((size_t) numBytes, &thCtx.bufferCapacity);
+			if (!thCtx.buffer)
+				return VideoReport_error(report, ERROR_ALLOC_OUTPUT_FRAME_BUFFER);
+
+			// Assign appropriate parts of buffer to image planes in frameRGB
+			av_image_fill_arrays(thCtx.frameRGB->data, thCtx.frameRGB->linesize, thCtx.buffer,
+								 PIXEL_FMT, outputWidth, outputHeight, align);
+			thCtx.frameRGB->width = outputWidth;
+			thCtx.frameRGB->height = outputHeight;
+			thCtx.frameRGB->format = PIXEL_FMT;
+		}
+
+		// Scaler is shared by all frames and videos of this worker with same input and output geometry.
+		thCtx.swsContext = thCtx.resources.scalers.get(
+				thCtx.tmpFrame->width, thCtx.tmpFrame->height, (AVPixelFormat) thCtx.tmpFrame->format,
+				outputWidth, outputHeight, PIXEL_FMT
+		);
+		if (!thCtx.swsContext)
+			return VideoReport_error(report, ERROR_SAVE_THUMBNAIL, "Unable to create scaler.");
+
+		// Convert the image from its native format to PIXEL_FMT
+		sws_scale(thCtx.swsContext, (uint8_t const* const*) thCtx.tmpFrame->data, thCtx.tmpFrame->linesize, 0,
+				  thCtx.tmpFrame->height, thCtx.frameRGB->data, thCtx.frameRGB->linesize);
+		return true;
+	}
+
+	// Return frame pixels as tightly packed RGBA. Rows are copied into given buffer only if frame rows are padded.
+	static const unsigned char* getPackedPixels(AVFrame* pFrame, std::vector<unsigned char>& buffer) {
+		// Output frames from scaleFrame() are tightly packed, so pixels can be used without copy.
+		if (pFrame->linesize[0] == pFrame->width * 4)
+			return pFrame->data[0];
+
+		buffer.resize((size_t) (pFrame->width * pFrame->height * 4));
 
 		// Write pixel data
 		for (int y = 0; y < pFrame->height; ++y)
-			memcpy(image.data() + (4 * pFrame->width * y), pFrame->data[0] + y * pFrame->linesize[0],
+			memcpy(buffer.data() + (4 * pFrame->width * y), pFrame->data[0] + y * pFrame->linesize[0],
 					(size_t)pFrame->width * 4);
 
-		unsigned ret = lodepng::encode(
-				generateThumbnailPath(thFolder, thName), image, (unsigned int) pFrame->width,
-				(unsigned int) pFrame->height);
-		if (ret)
-			return VideoReport_error(report, ERROR_PNG_ENCODER, lodepng_error_text(ret));
+		return buffer.data();
+	}
+
+	bool saveFrame(AVFrame* pFrame, const char* thFolder, const char* thName, int format,
+				   const VideoRaptorOptions* options) {
+		std::vector<unsigned char> buffer;
+		std::vector<unsigned char> encoded;
+		return encodeImage(encoded, getPackedPixels(pFrame, buffer), pFrame->width, pFrame->height, format, options, report)
+			   && writeImage(encoded, thFolder, thName, format, report);
+	}
 
+	// Write sprite geometry and, for each tile, its position and frame timestamp (in AV_TIME_BASE units).
+	bool saveSpriteIndex(const VideoFrames* videoFrames, int tileWidth, int tileHeight, int nbRows,
+						 const std::vector<int64_t>& timestamps) {
+		std::ofstream file(generateThumbnailPath(videoFrames->thumbnailFolder, videoFrames->thumbnailName, ".json"));
+		file << "{\"width\": " << tileWidth * videoFrames->nbColumns
+			 << ", \"height\": " << tileHeight * nbRows
+			 << ", \"tile_width\": " << tileWidth
+			 << ", \"tile_height\": " << tileHeight
+			 << ", \"columns\": " << videoFrames->nbColumns
+			 << ", \"rows\": " << nbRows
+			 << ", \"time_base\": " << AV_TIME_BASE
+			 << ", \"tiles\": [";
+		for (size_t k = 0; k < timestamps.size(); ++k) {
+			if (k)
+				file << ", ";
+			file << "{\"x\": " << (k % videoFrames->nbColumns) * tileWidth
+				 << ", \"y\": " << (k / videoFrames->nbColumns) * tileHeight
+				 << ", \"timestamp\": " << timestamps[k] << "}";
+		}
+		file << "]}" << std::endl;
+		if (!file)
+			return VideoReport_error(report, ERROR_SAVE_THUMBNAIL, "Unable to write sprite index.");
 		return true;
 	}
 
+	// Timestamp of decoded frame in AV_TIME_BASE units, or requested timestamp if frame has none.
+	int64_t getFrameTimestamp(const ThumbnailContext& thCtx, int64_t requestedTimestamp) const {
+		if (thCtx.frame->best_effort_timestamp == AV_NOPTS_VALUE)
+			return requestedTimestamp;
+		return av_rescale_q(thCtx.frame->best_effort_timestamp, videoStream.stream->time_base, AV_TIME_BASE_Q);
+	}
+
+	int64_t getRequestedTimestamp(const VideoFrames* videoFrames, int k) const {
+		return videoFrames->timestamps
+			   ? videoFrames->timestamps[k]
+			   : format->duration * (k + 1) / (videoFrames->nbFrames + 1);
+	}
+
+	// Tile all frames into one sprite image, encoded once, plus an index file.
+	bool generateSprite(VideoFrames* videoFrames, const VideoRaptorOptions* options, WorkerResources& resources) {
+		ThumbnailContext thCtx(resources);
+		int tileWidth, tileHeight;
+		getThumbnailSize(&tileWidth, &tileHeight, videoFrames->tileSize > 0 ? videoFrames->tileSize : THUMBNAIL_SIZE);
+		int nbRows = (videoFrames->nbFrames + videoFrames->nbColumns - 1) / videoFrames->nbColumns;
+		int spriteWidth = tileWidth * videoFrames->nbColumns;
+		int spriteHeight = tileHeight * nbRows;
+		std::vector<unsigned char> sprite((size_t) spriteWidth * spriteHeight * 4, 0);
+		std::vector<int64_t> timestamps;
+		setKeyframeDecoding(options);
+		for (int k = 0; k < videoFrames->nbFrames; ++k) {
+			int64_t timestamp = getRequestedTimestamp(videoFrames, k);
+			if (!decodeFrameAt(thCtx, timestamp, options) || !scaleFrame(thCtx, tileWidth, tileHeight))
+				return false;
+			timestamps.push_back(getFrameTimestamp(thCtx, timestamp));
+			// Copy tile into sprite.
+			size_t x = (size_t) (k % videoFrames->nbColumns) * tileWidth;
+			size_t y = (size_t) (k / videoFrames->nbColumns) * tileHeight;
+			for (int row = 0; row < tileHeight; ++row)
+				memcpy(sprite.data() + ((y + row) * spriteWidth + x) * 4,
+					   thCtx.frameRGB->data[0] + row * thCtx.frameRGB->linesize[0], (size_t) tileWidth * 4);
+		}
+		std::vector<unsigned char> encoded;
+		return encodeImage(encoded, sprite.data(), spriteWidth, spriteHeight, videoFrames->format, options, report)
+			   && writeImage(encoded, videoFrames->thumbnailFolder, videoFrames->thumbnailName, videoFrames->format, report)
+			   && saveSpriteIndex(videoFrames, tileWidth, tileHeight, nbRows, timestamps);
+	}
+
 public:
 
-	explicit Video(const char* filename, VideoReport* videoReport, HWDevices& devices, size_t deviceIndex) :
+	explicit Video(const char* filename, VideoReport* videoReport, HWDevices& devices, size_t deviceIndex,
+				   const VideoRaptorOptions* options) :
+			fileHandle(filename), format(nullptr), avioContext(nullptr),
+			audioStream(), videoStream(videoReport), report(videoReport), probeRetried(false), sentPackets(0) {
+		load(devices, deviceIndex, options);
+	}
+
+	// Open video for info extraction only (see extractInfo()), with probe budget from given options.
+	explicit Video(const char* filename, VideoReport* videoReport, const VideoRaptorOptions* options) :
 			fileHandle(filename), format(nullptr), avioContext(nullptr),
-			audioStream(), videoStream(videoReport), report(videoReport) {
-		load(devices, deviceIndex);
+			audioStream(), videoStream(videoReport), report(videoReport), probeRetried(false), sentPackets(0) {
+		loadMetadata(options);
 	}
 
 	~Video() {
-		if (avioContext) {
-			av_freep(&avioContext->buffer);
-			avio_context_free(&avioContext);
-		}
 		videoStream.clear();
 		audioStream.clear();
-		if (format) {
-			avformat_close_input(&format);
-		}
+		closeInputFile();
 	}
 
-	bool generateThumbnail(VideoThumbnail* videoThumbnail) {
-		ThumbnailContext thCtx;
-
-		int numBytes;
-		int align = 32;
-		int outputWidth = videoStream.codecContext->width;
-		int outputHeight = videoStream.codecContext->height;
-		if (outputWidth > THUMBNAIL_SIZE || outputHeight > THUMBNAIL_SIZE) {
-			if (outputWidth > outputHeight) {
-				outputHeight = THUMBNAIL_SIZE * outputHeight / outputWidth;
-				outputWidth = THUMBNAIL_SIZE;
-			} else if (outputWidth < outputHeight) {
-				outputWidth = THUMBNAIL_SIZE * outputWidth / outputHeight;
-				outputHeight = THUMBNAIL_SIZE;
-			} else {
-				outputWidth = outputHeight = THUMBNAIL_SIZE;
-			}
-		}
-
-		// seek
-		if (av_seek_frame(format, -1, format->duration / 2, AVSEEK_FLAG_BACKWARD) < 0)
-			return VideoReport_error(report, ERROR_SEEK_VIDEO);
+	// Return true if stream info had to be probed again with a bigger budget.
+	bool hasProbeRetried() const {
+		return probeRetried;
+	}
 
-		// Read frames and save first video frame as image to disk
-		while (av_read_frame(format, &thCtx.packet) >= 0) {
-			// Is this a packet from the video stream?
-			if (thCtx.packet.stream_index == videoStream.index) {
-				// Send packet
-				int ret = avcodec_send_packet(videoStream.codecContext, &thCtx.packet);
-				if (ret < 0)
-					return VideoReport_error(report, ERROR_SEND_PACKET);
-
-				// Allocate video frame
-				thCtx.frame = av_frame_alloc();
-				if (thCtx.frame == NULL)
-					return VideoReport_error(report, ERROR_ALLOC_INPUT_FRAME);
-
-				// Receive frame.
-				ret = avcodec_receive_frame(videoStream.codecContext, thCtx.frame);
-				if (ret == AVERROR(EAGAIN))
-					continue;
-				if (ret == AVERROR_EOF || ret < 0)
-					return VideoReport_error(report, ERROR_DECODE_VIDEO);
-
-				// Set frame to save (either from decoded frame or from GPU).
-				if (videoStream.selectedConfig && thCtx.frame->format == videoStream.selectedConfig->pix_fmt) {
-					// Allocate HW video frame
-					thCtx.swFrame = av_frame_alloc();
-					if (thCtx.swFrame == NULL)
-						return VideoReport_error(report, ERROR_ALLOC_HW_INPUT_FRAME);
-					// retrieve data from GPU to CPU
-					if (av_hwframe_transfer_data(thCtx.swFrame, thCtx.frame, 0) < 0)
-						return VideoReport_error(report, ERROR_HW_DATA_TRANSFER);
-					thCtx.tmpFrame = thCtx.swFrame;
-				} else {
-					thCtx.tmpFrame = thCtx.frame;
-				}
+	// Return number of video packets sent to decoder by generateThumbnail() and generateFrames().
+	int64_t countSentPackets() const {
+		return sentPackets;
+	}
 
-				// Allocate an AVFrame structure
-				thCtx.frameRGB = av_frame_alloc();
-				if (thCtx.frameRGB == NULL)
-					return VideoReport_error(report, ERROR_ALLOC_OUTPUT_FRAME);
-
-				// Determine required buffer size and allocate buffer
-				numBytes = av_image_get_buffer_size(PIXEL_FMT, outputWidth, outputHeight, align);
-				thCtx.buffer = (uint8_t*) av_malloc(numBytes * sizeof(uint8_t));
-				if (!thCtx.buffer)
-					return VideoReport_error(report, ERROR_ALLOC_OUTPUT_FRAME_BUFFER);
-
-				// Assign appropriate parts of buffer to image planes in frameRGB
-				av_image_fill_arrays(thCtx.frameRGB->data, thCtx.frameRGB->linesize, thCtx.buffer,
-									 PIXEL_FMT, outputWidth, outputHeight, align);
-
-				thCtx.swsContext = sws_getContext(
-						videoStream.codecContext->width, videoStream.codecContext->height,
-						(AVPixelFormat) thCtx.tmpFrame->format,
-						outputWidth, outputHeight, PIXEL_FMT, SWS_BILINEAR, NULL, NULL, NULL
-				);
-
-				// Convert the image from its native format to PIXEL_FMT
-				sws_scale(thCtx.swsContext, (uint8_t const* const*) thCtx.tmpFrame->data, thCtx.tmpFrame->linesize, 0,
-						  videoStream.codecContext->height, thCtx.frameRGB->data, thCtx.frameRGB->linesize);
-				// Save the frame to disk
-				thCtx.frameRGB->width = outputWidth;
-				thCtx.frameRGB->height = outputHeight;
-				thCtx.frameRGB->format = PIXEL_FMT;
-				return VideoReport_setDone(report, savePNG(thCtx.frameRGB, videoThumbnail->thumbnailFolder, videoThumbnail->thumbnailName));
-			}
+	bool generateThumbnail(VideoThumbnail* videoThumbnail, const VideoRaptorOptions* options, WorkerResources& resources) {
+		ThumbnailContext thCtx(resources);
+		int outputWidth, outputHeight;
+		getThumbnailSize(&outputWidth, &outputHeight);
+		setKeyframeDecoding(options);
+		int64_t timestamp = format->duration / 2;
+		if (!decodeFrameAt(thCtx, timestamp, options) || !scaleFrame(thCtx, outputWidth, outputHeight))
+			return false;
+		AVFrame* pFrame = thCtx.frameRGB;
+		timestamp = getFrameTimestamp(thCtx, timestamp);
+		std::vector<unsigned char> buffer;
+		const unsigned char* image = getPackedPixels(pFrame, buffer);
+		if (resources.encoder) {
+			// Encoder stage sets report when thumbnail is written.
+			resources.encoder->push(videoThumbnail, image, pFrame->width, pFrame->height, timestamp);
+			return true;
 		}
+		return VideoReport_setDone(report, outputThumbnail(image, pFrame->width, pFrame->height, timestamp,
+														   videoThumbnail, options, resources.pack, report));
+	}
 
-		return VideoReport_error(report, ERROR_SAVE_THUMBNAIL);
+	// Save many frames from this video, reusing demuxer, decoder, scaler and output frame for all frames.
+	// Frames are saved either as separate images, or tiled into one sprite if videoFrames->nbColumns > 0.
+	bool generateFrames(VideoFrames* videoFrames, const VideoRaptorOptions* options, WorkerResources& resources) {
+		if (videoFrames->nbColumns > 0)
+			return VideoReport_setDone(report, generateSprite(videoFrames, options, resources));
+		ThumbnailContext thCtx(resources);
+		int outputWidth, outputHeight;
+		getThumbnailSize(&outputWidth, &outputHeight);
+		setKeyframeDecoding(options);
+		for (int k = 0; k < videoFrames->nbFrames; ++k) {
+			int64_t timestamp = getRequestedTimestamp(videoFrames, k);
+			std::string frameName = videoFrames->thumbnailName;
+			frameName += '_';
+			frameName += std::to_string(k);
+			if (!decodeFrameAt(thCtx, timestamp, options)
+				|| !scaleFrame(thCtx, outputWidth, outputHeight)
+				|| !saveFrame(thCtx.frameRGB, videoFrames->thumbnailFolder, frameName.c_str(), videoFrames->format, options))
+				return false;
+		}
+		return VideoReport_setDone(report, true);
 	}
 
 	void extractInfo(VideoInfo* videoDetails) {
@@ -213,8 +433,8 @@ public:
 		videoDetails->duration_time_base = AV_TIME_BASE;
 		videoDetails->size = avio_size(format->pb);
 		videoDetails->container_format = copyString(format->iformat->long_name);
-		videoDetails->width = videoStream.codecContext->width;
-		videoDetails->height = videoStream.codecContext->height;
+		videoDetails->width = videoStream.stream->codecpar->width;
+		videoDetails->height = videoStream.stream->codecpar->height;
 		videoDetails->video_codec = copyString(videoStream.codec->name);
 		videoDetails->video_codec_description = copyString(videoStream.codec->long_name);
 		videoDetails->frame_rate_num = frame_rate->num;
@@ -222,8 +442,8 @@ public:
 		if (audioStream.index >= 0) {
 			videoDetails->audio_codec = copyString(audioStream.codec->name);
 			videoDetails->audio_codec_description = copyString(audioStream.codec->long_name);
-			videoDetails->sample_rate = audioStream.codecContext->sample_rate;
-			videoDetails->audio_bit_rate = audioStream.codecContext->bit_rate;
+			videoDetails->sample_rate = audioStream.stream->codecpar->sample_rate;
+			videoDetails->audio_bit_rate = audioStream.stream->codecpar->bit_rate;
 		}
 		if (AVDictionaryEntry* tag = av_dict_get(format->metadata, "title", NULL, AV_DICT_IGNORE_SUFFIX))
 			videoDetails->title = copyString(tag->value);
@@ -0,0 +1,33 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_VIDEOFRAMES_HPP
+#define VIDEORAPTOR_VIDEOFRAMES_HPP
+
+#include <cstdint>
+#include "VideoReport.hpp"
+#include "ThumbnailFormat.hpp"
+
+struct VideoFrames {
+	// Inputs:
+	const char* filename;
+	const char* thumbnailFolder;
+	const char* thumbnailName; // Frame k is saved as <thumbnailName>_<k>.png (extension depends on format)
+	int nbFrames;
+	const int64_t* timestamps; // Optional: nbFrames timestamps in AV_TIME_BASE units. If null, frames are evenly spaced.
+	int nbColumns; // If > 0, frames are tiled row by row into one sprite <thumbnailName>.png with this many columns,
+	// and tile positions and timestamps are written into <thumbnailName>.json.
+	int tileSize; // Maximum tile width and height in sprite. 0 means thumbnail size.
+	int format; // Image format of frames and sprite (see VideoRaptorThumbnailFormat). Default is PNG.
+	// Outputs:
+	VideoReport report;
+	// Use VideoReport_isDone(&videoFrames.report) to check if all frames were correctly generated.
+};
+
+extern "C" {
+	void VideoFrames_init(VideoFrames* videoFrames, const char* filename, const char* thumbnailFolder, const char* thumbnailName,
+						  int nbFrames, const int64_t* timestamps);
+}
+
+#endif //VIDEORAPTOR_VIDEOFRAMES_HPP
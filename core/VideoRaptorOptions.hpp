@@ -0,0 +1,59 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_VIDEORAPTOROPTIONS_HPP
+#define VIDEORAPTOR_VIDEORAPTOROPTIONS_HPP
+
+#include <cstdint>
+
+// Same values as FFmpeg FF_THREAD_FRAME and FF_THREAD_SLICE.
+enum VideoRaptorDecodeThreading {
+	DECODE_THREAD_FRAME = 1,	// Decode many frames in parallel. Adds a delay of one frame per thread before first output.
+	DECODE_THREAD_SLICE = 2,	// Decode slices of a frame in parallel, if codec and video support it.
+};
+
+struct VideoRaptorOptions {
+	// Inputs:
+	int nbWorkers; // Number of videos processed in parallel. 0 means automatic (see nbDecodeThreads).
+	int nbDecodeThreads; // Number of threads used to decode one video. 0 means automatic: processors / workers.
+	// If both nbWorkers and nbDecodeThreads are 0, workers count depends on batch length and file sizes: batches of
+	// small videos get one worker per video (up to one per processor), while batches with large videos (at least
+	// LARGE_VIDEO_COST bytes) get fewer workers, so that each large video is decoded with several threads.
+	int decodeThreadType; // Combination of VideoRaptorDecodeThreading flags. Default is slice threading only.
+	int scheduler; // How videos are distributed to workers (see VideoRaptorScheduler). Default is work stealing.
+	int64_t probeSize; // Maximum number of bytes read to get stream info. 0 means FFmpeg default.
+	int64_t analyzeDuration; // Maximum duration (in microseconds) analyzed to get stream info. 0 means FFmpeg default.
+	int adaptiveProbing; // If non-zero, retry with a bigger probe budget when video size, pixel format or frame rate is missing.
+	int keyframeThumbnails; // If non-zero, decoder skips non-key frames, and thumbnail is the keyframe at or before middle of video.
+	int lowresThumbnails; // If non-zero, decode at reduced resolution for thumbnails when codec supports it.
+	int pngProfile; // PNG encoder speed/size trade-off for thumbnails (see VideoRaptorPngProfile). Default is balanced.
+	int nbEncodeThreads; // Number of threads compressing one PNG (useful for sprites and big frames). 0 means automatic
+	// (processors / workers). Threads are used only if worker is alone, as OpenMP nested parallelism is off by default.
+	const char* thumbnailPack; // If not null, thumbnails are appended to this pack file and its index (see ThumbnailPack.hpp)
+	// instead of being saved as separate files. thumbnailFolder and thumbnailName are then ignored.
+	int encodeQueueSize; // If > 0, thumbnail batches are pipelined: workers only decode and scale, then queue frames
+	// (at most this many) for separate encoder threads which encode and write thumbnails. 0 means workers encode and write.
+	int nbEncoders; // Number of encoder threads in pipelined thumbnail batches. 0 means automatic (half the workers, at least 1).
+	// Outputs:
+	int nbWorkersUsed; // Number of workers used by last batch.
+	int nbDecodeThreadsUsed; // Number of decoding threads per video used by last batch.
+	int nbEncodeThreadsUsed; // Number of PNG compression threads per worker used by last batch.
+	double firstWorkerDoneTime; // Time (in seconds since start of last batch) when first worker ran out of videos.
+	double lastWorkerDoneTime; // Time (in seconds since start of last batch) when last worker finished.
+	int encodeQueueMaxDepth; // Maximum number of frames waiting for encoders in last pipelined batch.
+	double encodeQueueMeanDepth; // Mean number of frames waiting for encoders when a frame is queued, in last pipelined batch.
+	double decodeStageUtilisation; // Fraction of workers time not spent waiting for room in queue, until decoding ended, in last pipelined batch.
+	double encodeStageUtilisation; // Fraction of encoder threads time spent encoding and writing, in last pipelined batch.
+	int nbProbeRetries; // Number of videos whose stream info was probed again with a bigger budget, since options init.
+	int64_t nbThumbnailPackets; // Number of video packets sent to decoders to generate thumbnails, since options init.
+	int64_t nbScalerHits; // Number of frames scaled with a scaling context reused by worker, since options init.
+	int64_t nbScalerMisses; // Number of scaling contexts created, since options init.
+	int64_t nbPoolAllocations; // Number of frames and output buffers allocated by workers, since options init.
+};
+
+extern "C" {
+	void VideoRaptorOptions_init(VideoRaptorOptions* options);
+}
+
+#endif //VIDEORAPTOR_VIDEORAPTOROPTIONS_HPP
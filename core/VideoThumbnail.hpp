@@ -5,20 +5,27 @@
 #ifndef VIDEORAPTOR_VIDEOTHUMBNAIL_HPP
 #define VIDEORAPTOR_VIDEOTHUMBNAIL_HPP
 
+#include <cstddef>
 #include "VideoReport.hpp"
+#include "ThumbnailFormat.hpp"
 
 struct VideoThumbnail {
 	// Inputs:
 	const char* filename;
 	const char* thumbnailFolder;
 	const char* thumbnailName;
+	int format; // Thumbnail image format (see VideoRaptorThumbnailFormat), giving file extension. Default is PNG.
+	int inMemory; // If non-zero, thumbnail is not saved but returned in data. thumbnailFolder and thumbnailName are ignored.
 	// Outputs:
+	unsigned char* data; // Encoded thumbnail if inMemory is set. Free it with VideoThumbnail_clear().
+	size_t dataSize;
 	VideoReport report;
 	// Use VideoReport_isDone(&videoThumbnail.report) to check if thumbnail was correctly generated.
 };
 
 extern "C" {
 	void VideoThumbnail_init(VideoThumbnail* videoThumbnail, const char* filename, const char* thumbnailFolder, const char* thumbnailName);
+	void VideoThumbnail_clear(VideoThumbnail* videoThumbnail);
 }
 
 #endif //VIDEORAPTOR_VIDEOTHUMBNAIL_HPP
@@ -0,0 +1,24 @@
+//
+// Created by notoraptor on 17/10/2026.
+//
+
+#ifndef VIDEORAPTOR_WORKERRESOURCES_HPP
+#define VIDEORAPTOR_WORKERRESOURCES_HPP
+
+#include "EncodePipeline.hpp"
+#include "FramePool.hpp"
+#include "ScalerCache.hpp"
+#include "ThumbnailPack.hpp"
+
+// Resources owned by one batch worker, and reused across all videos processed by this worker.
+struct WorkerResources {
+	ScalerCache scalers;
+	FramePool frames;
+	ThumbnailPackWriter* pack; // Pack shared by all workers, or null if thumbnails are saved as separate files.
+	EncodePipeline* encoder; // Encoder stage shared by all workers, or null if workers encode their own thumbnails.
+
+	explicit WorkerResources(ThumbnailPackWriter* sharedPack = nullptr, EncodePipeline* sharedEncoder = nullptr):
+			scalers(), frames(), pack(sharedPack), encoder(sharedEncoder) {}
+};
+
+#endif //VIDEORAPTOR_WORKERRESOURCES_HPP
@@ -7,7 +7,11 @@ extern "C" {
 #include "utils.hpp"
 #include "VideoInfo.hpp"
 #include "VideoThumbnail.hpp"
+#include "VideoFrames.hpp"
 #include "VideoRaptorInfo.hpp"
+#include "VideoRaptorOptions.hpp"
+#include "BatchScheduler.hpp"
+#include "PngProfile.hpp"
 #include "ErrorReader.hpp"
 
 const char* errorCodeStrings[] = {
@@ -96,6 +100,37 @@ void VideoRaptorInfo_clear(VideoRaptorInfo* videoRaptorInfo) {
 	delete[] videoRaptorInfo->hardwareDevicesNames;
 }
 
+void VideoRaptorOptions_init(VideoRaptorOptions* options) {
+	options->nbWorkers = 0;
+	options->nbDecodeThreads = 0;
+	options->decodeThreadType = DECODE_THREAD_SLICE;
+	options->scheduler = SCHEDULER_WORK_STEALING;
+	options->probeSize = 0;
+	options->analyzeDuration = 0;
+	options->adaptiveProbing = 1;
+	options->keyframeThumbnails = 0;
+	options->lowresThumbnails = 1;
+	options->pngProfile = PNG_PROFILE_BALANCED;
+	options->nbEncodeThreads = 0;
+	options->thumbnailPack = nullptr;
+	options->encodeQueueSize = 0;
+	options->nbEncoders = 0;
+	options->nbWorkersUsed = 0;
+	options->nbDecodeThreadsUsed = 0;
+	options->nbEncodeThreadsUsed = 0;
+	options->firstWorkerDoneTime = 0;
+	options->lastWorkerDoneTime = 0;
+	options->encodeQueueMaxDepth = 0;
+	options->encodeQueueMeanDepth = 0;
+	options->decodeStageUtilisation = 0;
+	options->encodeStageUtilisation = 0;
+	options->nbProbeRetries = 0;
+	options->nbThumbnailPackets = 0;
+	options->nbScalerHits = 0;
+	options->nbScalerMisses = 0;
+	options->nbPoolAllocations = 0;
+}
+
 bool VideoReport_isDone(VideoReport* report) {
 	return report->errors & SUCCESS_DONE;
 }
@@ -112,9 +147,32 @@ void VideoThumbnail_init(VideoThumbnail* videoThumbnail, const char* filename, c
 	videoThumbnail->filename = filename;
 	videoThumbnail->thumbnailFolder = thumbnailFolder;
 	videoThumbnail->thumbnailName = thumbnailName;
+	videoThumbnail->format = THUMBNAIL_FORMAT_PNG;
+	videoThumbnail->inMemory = 0;
+	videoThumbnail->data = nullptr;
+	videoThumbnail->dataSize = 0;
 	VideoReport_init(&videoThumbnail->report);
 }
 
+void VideoThumbnail_clear(VideoThumbnail* videoThumbnail) {
+	delete[] videoThumbnail->data;
+	videoThumbnail->data = nullptr;
+	videoThumbnail->dataSize = 0;
+}
+
+void VideoFrames_init(VideoFrames* videoFrames, const char* filename, const char* thumbnailFolder, const char* thumbnailName,
+					  int nbFrames, const int64_t* timestamps) {
+	videoFrames->filename = filename;
+	videoFrames->thumbnailFolder = thumbnailFolder;
+	videoFrames->thumbnailName = thumbnailName;
+	videoFrames->nbFrames = nbFrames;
+	videoFrames->timestamps = timestamps;
+	videoFrames->nbColumns = 0;
+	videoFrames->tileSize = 0;
+	videoFrames->format = THUMBNAIL_FORMAT_PNG;
+	VideoReport_init(&videoFrames->report);
+}
+
 void VideoInfo_init(VideoInfo* videoInfo, const char* filename) {
 	videoInfo->filename = filename;
 	videoInfo->title = nullptr;
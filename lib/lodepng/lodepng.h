@@ -291,6 +291,13 @@ struct LodePNGCompressSettings /*deflate = compress*/
   unsigned minmatch; /*mininum lz77 length. 3 is normally best, 6 can be better for some PNGs. Default: 0*/
   unsigned nicematch; /*stop searching if >= this length found. Set to 258 for best compression. Default: 128*/
   unsigned lazymatching; /*use lazy matching: better compression but a bit slower. Default: true*/
+  unsigned maxchainlength; /*max hash chain entries tried per position, lower is faster. 0 means chosen from windowsize. Default: 0*/
+  /*threads used to compress deflate blocks (and adler32) in parallel, if compiled with OpenMP. Output is
+  slightly bigger: each block is primed with the previous window but ends on a byte boundary. 0 or 1: serial. Default: 0*/
+  unsigned numthreads;
+  /*highest instruction set used to compute the adler32 checksum, if the CPU supports it: 0 none
+  (scalar code), 1 SSSE3, 2 AVX2. Checksum is the same for all levels. Default: 2*/
+  unsigned simd;
 
   /*use custom zlib encoder instead of built in one (default: null)*/
   unsigned (*custom_zlib)(unsigned char**, size_t*,
@@ -609,6 +616,9 @@ typedef struct LodePNGEncoderSettings
   /*force creating a PLTE chunk if colortype is 2 or 6 (= a suggested palette).
   If colortype is 3, PLTE is _always_ created.*/
   unsigned force_palette;
+  /*highest instruction set used to filter scanlines, if the CPU supports it: 0 none (scalar code),
+  1 SSE2, 2 AVX2. Output is the same for all levels. Default: 2*/
+  unsigned simd;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   /*add LodePNG identifier and version as a text chunk, for debugging*/
   unsigned add_id;
@@ -1589,8 +1599,11 @@ state.encoder.zlibsettings.windowsize: tweak LZ77 windowsize
 state.encoder.zlibsettings.minmatch: tweak min LZ77 length to match
 state.encoder.zlibsettings.nicematch: tweak LZ77 match where to stop searching
 state.encoder.zlibsettings.lazymatching: try one more LZ77 matching
+state.encoder.zlibsettings.maxchainlength: limit LZ77 match search, for faster compression
+state.encoder.zlibsettings.numthreads: compress deflate blocks in parallel
 state.encoder.zlibsettings.custom_...: use custom deflate function
 state.encoder.auto_convert: choose optimal PNG color type, if 0 uses info_png
+state.encoder.simd: highest SIMD instruction set used for filtering, 0 to only use scalar code
 state.encoder.filter_palette_zero: PNG filter strategy for palette
 state.encoder.filter_strategy: PNG filter strategy to encode with
 state.encoder.force_palette: add palette even if not encoding to one
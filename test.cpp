@@ -3,9 +3,18 @@
 //
 
 #include <sstream>
+#include <chrono>
+#include <map>
+#include <vector>
 #include <core/VideoRaptorInfo.hpp>
 #include <videoRaptorBatch/videoRaptorBatch.hpp>
 #include <core/ErrorReader.hpp>
+#include <core/BatchScheduler.hpp>
+#include <core/EncodePipeline.hpp>
+#include <core/PngProfile.hpp>
+#include <core/QoiEncoder.hpp>
+#include <core/ThumbnailPack.hpp>
+#include <lib/lodepng/lodepng.h>
 #include <alignment/alignment.hpp>
 
 void printDetails(VideoInfo* videoDetails) {
@@ -71,11 +80,1127 @@ bool testThumbnail(const char* filename, const char* thumbName) {
 	return returnValue;
 }
 
+// Generate thumbnail in memory, without writing any file.
+bool testThumbnailInMemory(const char* filename, int format = THUMBNAIL_FORMAT_PNG) {
+	bool returnValue = false;
+	VideoThumbnail videoThumbnail;
+	VideoThumbnail_init(&videoThumbnail, filename, nullptr, nullptr);
+	videoThumbnail.format = format;
+	videoThumbnail.inMemory = 1;
+	VideoThumbnail* pVideoThumbnailInfo = &videoThumbnail;
+	videoRaptorThumbnails(1, &pVideoThumbnailInfo);
+	if (VideoReport_isDone(&videoThumbnail.report) && videoThumbnail.data) {
+		std::cout << "Thumbnail created in memory: " << videoThumbnail.dataSize << " bytes" << std::endl;
+		returnValue = true;
+	} else {
+		std::cout << "No thumbnail." << std::endl;
+	}
+	if (VideoReport_hasError(&videoThumbnail.report)) {
+		std::cout << "Video thumbnails: error(s) occurred (" << videoThumbnail.report.errors << ")." << std::endl;
+		VideoReport_print(&videoThumbnail.report);
+	}
+	VideoThumbnail_clear(&videoThumbnail);
+	return returnValue;
+}
+
+// Generate thumbnails for all videos into one pack, then read them back from pack index.
+bool testThumbnailPack(const std::vector<const char*>& filenames, const char* packFilename) {
+	std::vector<VideoThumbnail> videoThumbnails(filenames.size());
+	std::vector<VideoThumbnail*> pVideoThumbnails(filenames.size());
+	for (size_t i = 0; i < filenames.size(); ++i) {
+		VideoThumbnail_init(&videoThumbnails[i], filenames[i], nullptr, nullptr);
+		pVideoThumbnails[i] = &videoThumbnails[i];
+	}
+	VideoRaptorOptions options;
+	VideoRaptorOptions_init(&options);
+	options.thumbnailPack = packFilename;
+	int countLoaded = videoRaptorThumbnailsWithOptions(
+			(int) pVideoThumbnails.size(), pVideoThumbnails.data(), &options);
+	std::cout << "Packed " << countLoaded << "/" << filenames.size() << " thumbnail(s)." << std::endl;
+	void* pack = ThumbnailPack_open(packFilename);
+	if (!pack) {
+		std::cout << "Unable to open thumbnail pack." << std::endl;
+		return false;
+	}
+	bool returnValue = true;
+	for (size_t i = 0; i < filenames.size(); ++i) {
+		ThumbnailPackRecord record;
+		bool found = ThumbnailPack_find(pack, filenames[i], &record);
+		unsigned char* data = found ? ThumbnailPack_read(pack, &record) : nullptr;
+		if (VideoReport_isDone(&videoThumbnails[i].report) != found || (found && !data)) {
+			std::cout << "Pack mismatch for " << filenames[i] << std::endl;
+			returnValue = false;
+		} else if (found) {
+			std::cout << filenames[i] << ": " << record.width << "x" << record.height << " at " << record.timestamp
+					  << ", " << record.dataSize << " bytes" << std::endl;
+		}
+		ThumbnailPack_free(data);
+		if (VideoReport_hasError(&videoThumbnails[i].report))
+			VideoReport_print(&videoThumbnails[i].report);
+	}
+	ThumbnailPack_close(pack);
+	return returnValue;
+}
+
+// Write fake thumbnails into a pack in two sessions, from many threads, then check all can be read back.
+bool testThumbnailPackRoundTrip(const char* packFilename, int nbThumbnails) {
+	remove(packFilename);
+	remove((std::string(packFilename) + THUMBNAIL_PACK_INDEX_EXTENSION).c_str());
+	std::vector<VideoReport> reports((size_t) nbThumbnails);
+	for (int session = 0; session < 2; ++session) {
+		ThumbnailPackWriter writer(packFilename);
+		#pragma omp parallel for default(none) shared(writer, reports, nbThumbnails, session)
+		for (int i = 0; i < nbThumbnails; ++i) {
+			// Second session rewrites every other video, so that its latest entry changes.
+			if (session == 1 && i % 2)
+				continue;
+			std::vector<unsigned char> data((size_t) (1000 + 37 * i), (unsigned char) (i + session));
+			std::string name = "video_" + std::to_string(i);
+			VideoReport_init(&reports[i]);
+			writer.append(name.c_str(), data, i * 1000 + session, 300, 169, THUMBNAIL_FORMAT_PNG, &reports[i]);
+		}
+		if (writer.close())
+			return false;
+	}
+	ThumbnailPackReader reader(packFilename);
+	if (!reader.isOpen() || reader.getEntries().size() != (size_t) (nbThumbnails + (nbThumbnails + 1) / 2))
+		return false;
+	for (int i = 0; i < nbThumbnails; ++i) {
+		int session = i % 2 ? 0 : 1;
+		const ThumbnailPackEntry* entry = reader.find(("video_" + std::to_string(i)).c_str());
+		std::vector<unsigned char> data;
+		if (!entry || entry->timestamp != i * 1000 + session || entry->width != 300 || entry->height != 169
+			|| !reader.read(*entry, data)
+			|| data != std::vector<unsigned char>((size_t) (1000 + 37 * i), (unsigned char) (i + session)))
+			return false;
+	}
+	return true;
+}
+
+// Cut pack index in the middle of its last record, as an interrupted run would, then append a second run.
+// Check complete records of first run and all records of second run can be read back.
+bool testThumbnailPackRecovery(const char* packFilename, int nbThumbnails) {
+	std::string indexFilename = std::string(packFilename) + THUMBNAIL_PACK_INDEX_EXTENSION;
+	remove(packFilename);
+	remove(indexFilename.c_str());
+	VideoReport report;
+	for (int session = 0; session < 2; ++session) {
+		ThumbnailPackWriter writer(packFilename);
+		for (int i = 0; i < nbThumbnails; ++i) {
+			std::vector<unsigned char> data((size_t) (500 + i), (unsigned char) (i + session));
+			std::string name = "video_" + std::to_string(session) + "_" + std::to_string(i);
+			VideoReport_init(&report);
+			if (!writer.append(name.c_str(), data, i, 300, 169, THUMBNAIL_FORMAT_PNG, &report))
+				return false;
+		}
+		if (writer.close())
+			return false;
+		if (session == 0) {
+			std::vector<unsigned char> index;
+			if (!packReadFile(indexFilename, index))
+				return false;
+			FILE* file = fopen(indexFilename.c_str(), "wb");
+			size_t size = index.size() - 5;
+			bool written = file && fwrite(index.data(), 1, size, file) == size;
+			if (file)
+				fclose(file);
+			if (!written)
+				return false;
+		}
+	}
+	ThumbnailPackReader reader(packFilename);
+	if (!reader.isOpen() || reader.getEntries().size() != (size_t) (2 * nbThumbnails - 1))
+		return false;
+	for (int session = 0; session < 2; ++session) {
+		for (int i = 0; i < nbThumbnails; ++i) {
+			std::string name = "video_" + std::to_string(session) + "_" + std::to_string(i);
+			const ThumbnailPackEntry* entry = reader.find(name.c_str());
+			std::vector<unsigned char> data;
+			// Last record of first run was cut.
+			if (session == 0 && i == nbThumbnails - 1) {
+				if (entry)
+					return false;
+				continue;
+			}
+			if (!entry || !reader.read(*entry, data)
+				|| data != std::vector<unsigned char>((size_t) (500 + i), (unsigned char) (i + session)))
+				return false;
+		}
+	}
+	return true;
+}
+
+// Compare writing fake thumbnails as separate files versus appending them into a pack.
+void benchmarkThumbnailPack(const char* folder, int nbThumbnails, size_t thumbnailSize) {
+	std::vector<unsigned char> data(thumbnailSize, 127);
+	std::string packFilename = std::string(folder) + "/bench.pack";
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < nbThumbnails; ++i)
+		lodepng::save_file(data, std::string(folder) + "/bench_" + std::to_string(i) + ".png");
+	std::chrono::duration<double> separate = std::chrono::steady_clock::now() - start;
+	remove(packFilename.c_str());
+	remove((packFilename + THUMBNAIL_PACK_INDEX_EXTENSION).c_str());
+	start = std::chrono::steady_clock::now();
+	{
+		ThumbnailPackWriter writer(packFilename.c_str());
+		VideoReport report;
+		VideoReport_init(&report);
+		for (int i = 0; i < nbThumbnails; ++i)
+			writer.append(("video_" + std::to_string(i)).c_str(), data, 0, 300, 169, THUMBNAIL_FORMAT_PNG, &report);
+		writer.close();
+	}
+	std::chrono::duration<double> packed = std::chrono::steady_clock::now() - start;
+	std::cout << nbThumbnails << " thumbnails of " << thumbnailSize << " bytes: separate files "
+			  << separate.count() << " s, pack " << packed.count() << " s." << std::endl;
+}
+
+// Feed fake frames through encoder stage from many threads, with thumbnails returned in memory,
+// then check every thumbnail decodes back to its frame.
+bool testEncodePipeline(int nbThumbnails, int queueSize, int nbEncoders) {
+	const int width = 64, height = 36;
+	std::vector<VideoThumbnail> videoThumbnails((size_t) nbThumbnails);
+	VideoRaptorOptions options;
+	VideoRaptorOptions_init(&options);
+	options.nbWorkersUsed = 4;
+	options.nbEncodeThreadsUsed = 1;
+	{
+		EncodePipeline encoder((size_t) queueSize, nbEncoders, &options, nullptr);
+		#pragma omp parallel for num_threads(4) default(none) shared(videoThumbnails, encoder, nbThumbnails)
+		for (int i = 0; i < nbThumbnails; ++i) {
+			std::vector<unsigned char> image((size_t) width * height * 4, (unsigned char) i);
+			VideoThumbnail_init(&videoThumbnails[i], "fake", nullptr, nullptr);
+			videoThumbnails[i].inMemory = 1;
+			encoder.push(&videoThumbnails[i], image.data(), width, height, i);
+		}
+		encoder.endDecoding();
+		if (encoder.close(&options))
+			return false;
+	}
+	bool returnValue = true;
+	for (int i = 0; i < nbThumbnails; ++i) {
+		std::vector<unsigned char> pixels;
+		unsigned w, h;
+		if (!VideoReport_isDone(&videoThumbnails[i].report)
+			|| lodepng::decode(pixels, w, h, videoThumbnails[i].data, videoThumbnails[i].dataSize)
+			|| pixels != std::vector<unsigned char>((size_t) width * height * 4, (unsigned char) i))
+			returnValue = false;
+		VideoThumbnail_clear(&videoThumbnails[i]);
+	}
+	std::cout << "Encoder stage: max queue depth " << options.encodeQueueMaxDepth
+			  << ", mean " << options.encodeQueueMeanDepth
+			  << ", decode utilisation " << options.decodeStageUtilisation
+			  << ", encode utilisation " << options.encodeStageUtilisation << std::endl;
+	return returnValue;
+}
+
+// Compare thumbnail batch with workers encoding their own thumbnails versus pipelined encoder stage.
+void benchmarkEncodePipeline(const std::vector<const char*>& filenames, const char* thumbnailFolder, int queueSize) {
+	std::vector<std::string> thumbNames;
+	for (size_t i = 0; i < filenames.size(); ++i)
+		thumbNames.push_back("pipeline_" + std::to_string(i));
+	for (int pipelined = 0; pipelined < 2; ++pipelined) {
+		std::vector<VideoThumbnail> videoThumbnails(filenames.size());
+		std::vector<VideoThumbnail*> pVideoThumbnails(filenames.size());
+		for (size_t i = 0; i < filenames.size(); ++i) {
+			VideoThumbnail_init(&videoThumbnails[i], filenames[i], thumbnailFolder, thumbNames[i].c_str());
+			pVideoThumbnails[i] = &videoThumbnails[i];
+		}
+		VideoRaptorOptions options;
+		VideoRaptorOptions_init(&options);
+		options.encodeQueueSize = pipelined ? queueSize : 0;
+		auto start = std::chrono::steady_clock::now();
+		int countLoaded = videoRaptorThumbnailsWithOptions(
+				(int) pVideoThumbnails.size(), pVideoThumbnails.data(), &options);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << (pipelined ? "Pipelined" : "Not pipelined") << ": " << countLoaded << "/" << filenames.size()
+				  << " thumbnail(s) in " << elapsed.count() << " s." << std::endl;
+		if (pipelined)
+			std::cout << "Max queue depth " << options.encodeQueueMaxDepth
+					  << ", mean " << options.encodeQueueMeanDepth
+					  << ", decode utilisation " << options.decodeStageUtilisation
+					  << ", encode utilisation " << options.encodeStageUtilisation << std::endl;
+	}
+}
+
+// If nbColumns > 0, frames are saved as a sprite.
+bool testFrames(const char* filename, const char* thumbName, int nbFrames, int nbColumns = 0) {
+	bool returnValue = false;
+	VideoFrames videoFrames;
+	VideoFrames_init(&videoFrames, filename, ".", thumbName, nbFrames, nullptr);
+	videoFrames.nbColumns = nbColumns;
+	VideoFrames* pVideoFrames = &videoFrames;
+	videoRaptorFrames(1, &pVideoFrames, nullptr);
+	if (VideoReport_isDone(&videoFrames.report)) {
+		if (nbColumns > 0)
+			std::cout << "Sprite created: " << thumbName << ".png, index: " << thumbName << ".json" << std::endl;
+		else
+			std::cout << "Frames created: " << thumbName << "_0.png to " << thumbName << "_" << nbFrames - 1 << ".png" << std::endl;
+		returnValue = true;
+	} else {
+		std::cout << "No frames." << std::endl;
+	}
+	if (VideoReport_hasError(&videoFrames.report)) {
+		std::cout << "Video frames: error(s) occurred (" << videoFrames.report.errors << ")." << std::endl;
+		VideoReport_print(&videoFrames.report);
+	}
+	return returnValue;
+}
+
 void test(const char* filename, const char* thumbName) {
 	if (testDetails(filename))
 		testThumbnail(filename, thumbName);
 }
 
+// Compare batch wall time (i.e. time until last video is done) for each scheduler, and batch tail,
+// i.e. time between first and last worker running out of videos (e.g. a big video started last by one worker).
+void benchmarkSchedulers(const std::vector<const char*>& filenames, const char* thumbnailFolder, int nbWorkers) {
+	const int schedulers[] = {SCHEDULER_STATIC, SCHEDULER_WORK_STEALING};
+	const char* schedulerNames[] = {"static", "work stealing"};
+	std::vector<std::string> thumbNames;
+	for (size_t i = 0; i < filenames.size(); ++i)
+		thumbNames.push_back("bench_" + std::to_string(i));
+	for (int s = 0; s < 2; ++s) {
+		std::vector<VideoThumbnail> videoThumbnails(filenames.size());
+		std::vector<VideoThumbnail*> pVideoThumbnails(filenames.size());
+		for (size_t i = 0; i < filenames.size(); ++i) {
+			VideoThumbnail_init(&videoThumbnails[i], filenames[i], thumbnailFolder, thumbNames[i].c_str());
+			pVideoThumbnails[i] = &videoThumbnails[i];
+		}
+		VideoRaptorOptions options;
+		VideoRaptorOptions_init(&options);
+		options.nbWorkers = nbWorkers;
+		options.scheduler = schedulers[s];
+		auto start = std::chrono::steady_clock::now();
+		int countLoaded = videoRaptorThumbnailsWithOptions(
+				(int) pVideoThumbnails.size(), pVideoThumbnails.data(), &options);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << "Scheduler " << schedulerNames[s] << ": " << countLoaded << "/" << filenames.size()
+				  << " thumbnail(s) in " << elapsed.count() << " s, first worker done at "
+				  << options.firstWorkerDoneTime << " s, last at " << options.lastWorkerDoneTime << " s, tail "
+				  << options.lastWorkerDoneTime - options.firstWorkerDoneTime << " s." << std::endl;
+	}
+}
+
+// Generate thumbnail for one video with given options. Return elapsed time in seconds.
+double timeThumbnail(const char* filename, const char* thumbName, VideoRaptorOptions* options) {
+	VideoThumbnail videoThumbnail;
+	VideoThumbnail_init(&videoThumbnail, filename, ".", thumbName);
+	VideoThumbnail* pVideoThumbnail = &videoThumbnail;
+	auto start = std::chrono::steady_clock::now();
+	videoRaptorThumbnailsWithOptions(1, &pVideoThumbnail, options);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	if (!VideoReport_isDone(&videoThumbnail.report))
+		std::cout << "No thumbnail for " << filename << std::endl;
+	return elapsed.count();
+}
+
+// Compare packets decoded and time per video, with and without keyframe-only decoding.
+void benchmarkKeyframeThumbnails(const std::vector<const char*>& filenames) {
+	for (const char* filename : filenames) {
+		for (int keyframeThumbnails = 0; keyframeThumbnails < 2; ++keyframeThumbnails) {
+			VideoRaptorOptions options;
+			VideoRaptorOptions_init(&options);
+			options.nbWorkers = 1;
+			options.keyframeThumbnails = keyframeThumbnails;
+			double elapsed = timeThumbnail(filename, "bench_keyframe", &options);
+			std::cout << filename << (keyframeThumbnails ? " [keyframe]: " : " [default]: ")
+					  << options.nbThumbnailPackets << " packet(s) decoded, " << elapsed * 1000 << " ms." << std::endl;
+		}
+	}
+}
+
+// Compare thumbnail time with and without reduced-resolution decoding, per video codec.
+void benchmarkLowresThumbnails(const std::vector<const char*>& filenames) {
+	std::map<std::string, double> codecTimes[2];
+	std::map<std::string, int> codecCounts;
+	for (const char* filename : filenames) {
+		VideoInfo videoInfo;
+		VideoInfo_init(&videoInfo, filename);
+		VideoInfo* pVideoInfo = &videoInfo;
+		videoRaptorDetails(1, &pVideoInfo);
+		std::string codec = videoInfo.video_codec ? videoInfo.video_codec : "(unknown)";
+		VideoInfo_clear(&videoInfo);
+		++codecCounts[codec];
+		for (int lowresThumbnails = 0; lowresThumbnails < 2; ++lowresThumbnails) {
+			VideoRaptorOptions options;
+			VideoRaptorOptions_init(&options);
+			options.nbWorkers = 1;
+			options.lowresThumbnails = lowresThumbnails;
+			double elapsed = timeThumbnail(filename, "bench_lowres", &options);
+			codecTimes[lowresThumbnails][codec] += elapsed;
+			std::cout << filename << " (" << codec << ")" << (lowresThumbnails ? " [lowres]: " : " [default]: ")
+					  << elapsed * 1000 << " ms." << std::endl;
+		}
+	}
+	for (auto& entry : codecCounts) {
+		std::cout << entry.first << ": " << entry.second << " video(s), default "
+				  << codecTimes[0][entry.first] * 1000 / entry.second << " ms/video, lowres "
+				  << codecTimes[1][entry.first] * 1000 / entry.second << " ms/video." << std::endl;
+	}
+}
+
+// Fill an RGBA image (with given row stride) with a gradient and some noise, to look like a video frame.
+void fillTestImage(unsigned char* image, int width, int height, size_t stride) {
+	unsigned int seed = 12345;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			seed = seed * 1103515245 + 12345;
+			unsigned char* pixel = image + y * stride + x * 4;
+			pixel[0] = (unsigned char) (x + (seed >> 28));
+			pixel[1] = (unsigned char) (y + (seed >> 28));
+			pixel[2] = (unsigned char) ((x + y) / 2);
+			pixel[3] = 255;
+		}
+	}
+}
+
+// Fill an RGBA image with smooth content closer to a video frame: gradients, flat blocks and light grain.
+void fillSmoothTestImage(unsigned char* image, int width, int height, size_t stride) {
+	unsigned int seed = 54321;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			seed = seed * 1103515245 + 12345;
+			unsigned char* pixel = image + y * stride + x * 4;
+			int block = ((x / 40) + (y / 30)) % 3;
+			pixel[0] = (unsigned char) (block == 0 ? 200 : x * 255 / width);
+			pixel[1] = (unsigned char) (block == 1 ? 60 : y * 255 / height);
+			pixel[2] = (unsigned char) (96 + (block * 40) + (seed >> 30));
+			pixel[3] = 255;
+		}
+	}
+}
+
+// Compare PNG encoding of a padded frame (rows first copied into a new packed image, as before)
+// with direct encoding of a tightly packed frame.
+void benchmarkPackedEncoding(int nbIterations) {
+	const int sizes[][2] = {{300, 300}, {300, 169}};
+	for (const auto& size : sizes) {
+		int width = size[0];
+		int height = size[1];
+		size_t packedStride = (size_t) width * 4;
+		size_t paddedStride = (packedStride + 31) / 32 * 32;
+		std::vector<unsigned char> padded(paddedStride * height);
+		std::vector<unsigned char> packed(packedStride * height);
+		fillTestImage(padded.data(), width, height, paddedStride);
+		fillTestImage(packed.data(), width, height, packedStride);
+		std::vector<unsigned char> png;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < nbIterations; ++i) {
+			std::vector<unsigned char> image(packedStride * height);
+			for (int y = 0; y < height; ++y)
+				memcpy(image.data() + y * packedStride, padded.data() + y * paddedStride, packedStride);
+			png.clear();
+			lodepng::encode(png, image, (unsigned) width, (unsigned) height);
+		}
+		std::chrono::duration<double> copyTime = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < nbIterations; ++i) {
+			png.clear();
+			lodepng::encode(png, packed.data(), (unsigned) width, (unsigned) height);
+		}
+		std::chrono::duration<double> directTime = std::chrono::steady_clock::now() - start;
+
+		std::cout << width << "x" << height << ": copy + encode " << copyTime.count() * 1000 / nbIterations
+				  << " ms, direct encode " << directTime.count() * 1000 / nbIterations << " ms." << std::endl;
+	}
+}
+
+// Print encode time and output size of each PNG profile on a fixed corpus of synthetic frames
+// (noisy and smooth): thumbnail sizes for square and landscape videos, and a 4x4 sprite of 300x169 tiles.
+void benchmarkPngProfiles(int nbIterations) {
+	const int sizes[][2] = {{300, 300}, {300, 169}, {1200, 676}};
+	const int profiles[] = {PNG_PROFILE_FASTEST, PNG_PROFILE_BALANCED, PNG_PROFILE_SMALLEST};
+	const char* profileNames[] = {"balanced", "fastest", "smallest"}; // Indexed by profile.
+	void (* fillers[])(unsigned char*, int, int, size_t) = {fillTestImage, fillSmoothTestImage};
+	const char* fillerNames[] = {"noisy", "smooth"};
+	std::cout << "profile\tframe\tsize\tencode (ms)\toutput (bytes)" << std::endl;
+	for (int profile : profiles) {
+		for (int f = 0; f < 2; ++f) {
+			for (const auto& size : sizes) {
+				unsigned width = (unsigned) size[0];
+				unsigned height = (unsigned) size[1];
+				std::vector<unsigned char> image((size_t) width * height * 4);
+				fillers[f](image.data(), size[0], size[1], (size_t) width * 4);
+				std::vector<unsigned char> png;
+				auto start = std::chrono::steady_clock::now();
+				for (int i = 0; i < nbIterations; ++i) {
+					lodepng::State state;
+					std::vector<unsigned char> filters;
+					configurePngProfile(state, profile, height, filters);
+					png.clear();
+					lodepng::encode(png, image.data(), width, height, state);
+				}
+				std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+				std::cout << profileNames[profile] << '\t' << fillerNames[f] << '\t' << width << 'x' << height << '\t'
+						  << duration.count() * 1000 / nbIterations << '\t' << png.size() << std::endl;
+			}
+		}
+	}
+}
+
+// Compare serial and parallel PNG compression of a 4K frame and a big sprite sheet,
+// and check that parallel output decodes to the same pixels.
+void benchmarkParallelDeflate(unsigned nbThreads) {
+	const int sizes[][2] = {{1200, 676}, {3840, 2160}};
+	for (const auto& size : sizes) {
+		unsigned width = (unsigned) size[0];
+		unsigned height = (unsigned) size[1];
+		std::vector<unsigned char> image((size_t) width * height * 4);
+		fillSmoothTestImage(image.data(), size[0], size[1], (size_t) width * 4);
+		for (unsigned threads : {1u, nbThreads}) {
+			lodepng::State state;
+			std::vector<unsigned char> png;
+			std::vector<unsigned char> decoded;
+			unsigned decodedWidth, decodedHeight;
+			state.encoder.zlibsettings.numthreads = threads;
+			auto start = std::chrono::steady_clock::now();
+			unsigned error = lodepng::encode(png, image.data(), width, height, state);
+			std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+			if (!error)
+				error = lodepng::decode(decoded, decodedWidth, decodedHeight, png);
+			std::cout << width << "x" << height << ", " << threads << " thread(s): " << duration.count() * 1000
+					  << " ms, " << png.size() << " bytes, "
+					  << (error ? lodepng_error_text(error) : decoded == image ? "same pixels" : "DIFFERENT PIXELS")
+					  << std::endl;
+		}
+	}
+}
+
+// Check that PNG files encoded with SIMD scanline filters are the same as with scalar filters,
+// for all filter strategies, many pixel sizes and widths not multiple of vector sizes.
+bool testSimdFilters() {
+	const LodePNGColorType colorTypes[] = {LCT_GREY, LCT_GREY_ALPHA, LCT_RGB, LCT_RGBA};
+	const LodePNGFilterStrategy strategies[] = {LFS_ZERO, LFS_MINSUM, LFS_ENTROPY, LFS_PREDEFINED};
+	const unsigned widths[] = {1, 5, 17, 33, 300};
+	const unsigned height = 23;
+	unsigned seed = 2019;
+	bool ok = true;
+	for (LodePNGColorType colorType : colorTypes) {
+		for (unsigned bitDepth : {8u, 16u}) {
+			for (unsigned width : widths) {
+				LodePNGColorMode mode;
+				lodepng_color_mode_init(&mode);
+				mode.colortype = colorType;
+				mode.bitdepth = bitDepth;
+				std::vector<unsigned char> image(lodepng_get_raw_size(width, height, &mode));
+				for (unsigned char& byte : image) {
+					seed = seed * 1103515245 + 12345;
+					byte = (unsigned char) ((seed >> 16) % 7 == 0 ? seed >> 24 : (seed >> 28) + 100);
+				}
+				std::vector<unsigned char> filters(height);
+				for (unsigned y = 0; y < height; ++y)
+					filters[y] = (unsigned char) (y % 5);
+				for (LodePNGFilterStrategy strategy : strategies) {
+					std::vector<unsigned char> reference;
+					for (unsigned simd = 0; simd <= 2; ++simd) {
+						lodepng::State state;
+						std::vector<unsigned char> png;
+						state.info_raw.colortype = state.info_png.color.colortype = colorType;
+						state.info_raw.bitdepth = state.info_png.color.bitdepth = bitDepth;
+						state.encoder.auto_convert = 0;
+						state.encoder.filter_strategy = strategy;
+						state.encoder.predefined_filters = filters.data();
+						state.encoder.simd = simd;
+						unsigned error = lodepng::encode(png, image.data(), width, height, state);
+						if (error || (simd && png != reference)) {
+							std::cout << "SIMD filters mismatch: color type " << colorType << ", " << bitDepth
+									  << " bits, width " << width << ", strategy " << strategy << ", level " << simd
+									  << (error ? ": " : "") << (error ? lodepng_error_text(error) : "") << std::endl;
+							ok = false;
+						}
+						if (!simd)
+							reference = png;
+					}
+				}
+			}
+		}
+	}
+	std::cout << "SIMD filters " << (ok ? "OK" : "FAILED") << std::endl;
+	return ok;
+}
+
+// Compare scanline filtering time with minimum sum heuristic for each SIMD level,
+// on RGBA thumbnails stored without compression so that filtering dominates.
+void benchmarkSimdFilters(int nbIterations) {
+	const int sizes[][2] = {{300, 300}, {300, 169}};
+	const char* levelNames[] = {"scalar", "SSE2", "AVX2"};
+	for (const auto& size : sizes) {
+		unsigned width = (unsigned) size[0];
+		unsigned height = (unsigned) size[1];
+		std::vector<unsigned char> image((size_t) width * height * 4);
+		fillSmoothTestImage(image.data(), size[0], size[1], (size_t) width * 4);
+		for (unsigned simd = 0; simd <= 2; ++simd) {
+			std::vector<unsigned char> png;
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < nbIterations; ++i) {
+				lodepng::State state;
+				state.encoder.zlibsettings.btype = 0;
+				state.encoder.auto_convert = 0;
+				state.encoder.simd = simd;
+				png.clear();
+				lodepng::encode(png, image.data(), width, height, state);
+			}
+			std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+			std::cout << width << "x" << height << " " << levelNames[simd] << ": "
+					  << duration.count() * 1000 / nbIterations << " ms" << std::endl;
+		}
+	}
+}
+
+unsigned referenceCrc32(const unsigned char* data, size_t length) {
+	unsigned crc = 0xffffffffu;
+	for (size_t i = 0; i < length; ++i) {
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; ++bit)
+			crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1u)));
+	}
+	return crc ^ 0xffffffffu;
+}
+
+unsigned referenceAdler32(const unsigned char* data, size_t length) {
+	unsigned s1 = 1, s2 = 0;
+	for (size_t i = 0; i < length; ++i) {
+		s1 = (s1 + data[i]) % 65521;
+		s2 = (s2 + s1) % 65521;
+	}
+	return (s2 << 16) | s1;
+}
+
+// Adler-32 computed by lodepng at given SIMD level: last 4 bytes of an uncompressed zlib stream.
+unsigned lodepngAdler32(const unsigned char* data, size_t length, unsigned simd) {
+	LodePNGCompressSettings settings;
+	lodepng_compress_settings_init(&settings);
+	settings.btype = 0;
+	settings.simd = simd;
+	std::vector<unsigned char> zlib;
+	lodepng::compress(zlib, data, length, settings);
+	size_t end = zlib.size();
+	return ((unsigned) zlib[end - 4] << 24) | ((unsigned) zlib[end - 3] << 16) | ((unsigned) zlib[end - 2] << 8) | zlib[end - 1];
+}
+
+// Compare CRC-32 and Adler-32 of lodepng (at every SIMD level) with bytewise reference implementations,
+// on random buffers of random lengths and alignments, and on worst case buffers (all bytes 255).
+bool testChecksums(int nbTrials) {
+	std::vector<unsigned char> buffer(200000 + 64);
+	unsigned seed = 1234;
+	bool ok = true;
+	for (int trial = 0; trial < nbTrials && ok; ++trial) {
+		seed = seed * 1103515245 + 12345;
+		size_t length = trial % 4 == 0 ? (seed >> 8) % 200000 : (seed >> 8) % 100;
+		size_t offset = (seed >> 4) % 64;
+		bool saturated = trial % 10 == 9;
+		for (size_t i = 0; i < offset + length; ++i) {
+			seed = seed * 1103515245 + 12345;
+			buffer[i] = saturated ? 255 : (unsigned char) (seed >> 24);
+		}
+		const unsigned char* data = buffer.data() + offset;
+		if (lodepng_crc32(data, length) != referenceCrc32(data, length)) {
+			std::cout << "CRC-32 mismatch, length " << length << ", offset " << offset << std::endl;
+			ok = false;
+		}
+		unsigned adler = referenceAdler32(data, length);
+		for (unsigned simd = 0; simd <= 2; ++simd) {
+			if (lodepngAdler32(data, length, simd) != adler) {
+				std::cout << "Adler-32 mismatch, level " << simd << ", length " << length << ", offset " << offset
+						  << std::endl;
+				ok = false;
+			}
+		}
+	}
+	std::cout << "Checksums " << (ok ? "OK" : "FAILED") << std::endl;
+	return ok;
+}
+
+// Compare bytewise and lodepng CRC-32 throughput on 16 MiB of data.
+void benchmarkChecksums(int nbIterations) {
+	std::vector<unsigned char> buffer((size_t) 16 << 20);
+	fillSmoothTestImage(buffer.data(), 1024, 4096, 4096);
+	double megabytes = buffer.size() / 1048576.0;
+	unsigned check = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < nbIterations; ++i)
+		check ^= referenceCrc32(buffer.data(), buffer.size());
+	std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	std::cout << "CRC-32 bitwise: " << megabytes * nbIterations / duration.count() << " MiB/s" << std::endl;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < nbIterations; ++i)
+		check ^= lodepng_crc32(buffer.data(), buffer.size());
+	duration = std::chrono::steady_clock::now() - start;
+	std::cout << "CRC-32 lodepng: " << megabytes * nbIterations / duration.count() << " MiB/s" << std::endl;
+	std::cout << "(check " << check << ")" << std::endl;
+}
+
+// Minimal QOI decoder to check encoded thumbnails. Return false if data is not a valid 4-channel QOI image.
+bool decodeQOI(const std::vector<unsigned char>& data, std::vector<unsigned char>& pixels, unsigned* width, unsigned* height) {
+	if (data.size() < QOI_HEADER_SIZE + QOI_PADDING_SIZE || memcmp(data.data(), "qoif", 4) != 0 || data[12] != 4)
+		return false;
+	*width = ((unsigned) data[4] << 24) | ((unsigned) data[5] << 16) | ((unsigned) data[6] << 8) | data[7];
+	*height = ((unsigned) data[8] << 24) | ((unsigned) data[9] << 16) | ((unsigned) data[10] << 8) | data[11];
+	size_t nbPixels = (size_t) *width * *height;
+	size_t end = data.size() - QOI_PADDING_SIZE;
+	size_t position = QOI_HEADER_SIZE;
+	unsigned char index[64][4] = {};
+	unsigned char pixel[4] = {0, 0, 0, 255};
+	int run = 0;
+	pixels.resize(nbPixels * 4);
+	for (size_t i = 0; i < nbPixels; ++i) {
+		if (run > 0) {
+			--run;
+		} else {
+			if (position >= end)
+				return false;
+			unsigned char tag = data[position++];
+			if (tag == QOI_OP_RGB) {
+				memcpy(pixel, &data[position], 3);
+				position += 3;
+			} else if (tag == QOI_OP_RGBA) {
+				memcpy(pixel, &data[position], 4);
+				position += 4;
+			} else if ((tag & 0xc0) == QOI_OP_INDEX) {
+				memcpy(pixel, index[tag], 4);
+			} else if ((tag & 0xc0) == QOI_OP_DIFF) {
+				pixel[0] += ((tag >> 4) & 3) - 2;
+				pixel[1] += ((tag >> 2) & 3) - 2;
+				pixel[2] += (tag & 3) - 2;
+			} else if ((tag & 0xc0) == QOI_OP_LUMA) {
+				unsigned char next = data[position++];
+				int dg = (tag & 0x3f) - 32;
+				pixel[0] += dg - 8 + ((next >> 4) & 0x0f);
+				pixel[1] += dg;
+				pixel[2] += dg - 8 + (next & 0x0f);
+			} else {
+				run = tag & 0x3f;
+			}
+			memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+		}
+		memcpy(&pixels[i * 4], pixel, 4);
+	}
+	return position == end && memcmp(&data[end], "\0\0\0\0\0\0\0\1", QOI_PADDING_SIZE) == 0;
+}
+
+// Check that QOI thumbnails decode to the encoded pixels: noisy, smooth, transparent and long runs.
+bool testQOI() {
+	const int sizes[][2] = {{300, 169}, {1, 1}, {257, 3}};
+	bool ok = true;
+	for (const auto& size : sizes) {
+		unsigned width = (unsigned) size[0];
+		unsigned height = (unsigned) size[1];
+		for (int variant = 0; variant < 4; ++variant) {
+			std::vector<unsigned char> image((size_t) width * height * 4);
+			if (variant == 0)
+				fillTestImage(image.data(), size[0], size[1], (size_t) width * 4);
+			else
+				fillSmoothTestImage(image.data(), size[0], size[1], (size_t) width * 4);
+			if (variant == 2)
+				for (size_t i = 3; i < image.size(); i += 4 * 7)
+					image[i] = (unsigned char) i;
+			if (variant == 3)
+				std::fill(image.begin(), image.begin() + image.size() / 2, 0);
+			std::vector<unsigned char> qoi;
+			std::vector<unsigned char> decoded;
+			unsigned decodedWidth = 0, decodedHeight = 0;
+			encodeQOI(qoi, image.data(), width, height);
+			if (!decodeQOI(qoi, decoded, &decodedWidth, &decodedHeight) || decodedWidth != width
+				|| decodedHeight != height || decoded != image) {
+				std::cout << "QOI mismatch: " << width << "x" << height << ", variant " << variant << std::endl;
+				ok = false;
+			}
+		}
+	}
+	std::cout << "QOI " << (ok ? "OK" : "FAILED") << std::endl;
+	return ok;
+}
+
+// Compare PNG (each profile) and QOI encoding of RGBA thumbnails:
+// time per thumbnail, throughput in MB/s of raw RGBA input, and output size.
+void benchmarkThumbnailFormats(int nbIterations) {
+	const int sizes[][2] = {{300, 300}, {300, 169}};
+	const char* profileNames[] = {"PNG balanced", "PNG fastest", "PNG smallest"};
+	for (const auto& size : sizes) {
+		unsigned width = (unsigned) size[0];
+		unsigned height = (unsigned) size[1];
+		std::vector<unsigned char> image((size_t) width * height * 4);
+		fillSmoothTestImage(image.data(), size[0], size[1], (size_t) width * 4);
+		double megabytes = image.size() / 1e6;
+		for (int format = 0; format < 4; ++format) {
+			std::vector<unsigned char> encoded;
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < nbIterations; ++i) {
+				encoded.clear();
+				if (format == 3) {
+					encodeQOI(encoded, image.data(), width, height);
+				} else {
+					lodepng::State state;
+					std::vector<unsigned char> filters;
+					configurePngProfile(state, format, height, filters);
+					lodepng::encode(encoded, image.data(), width, height, state);
+				}
+			}
+			std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+			std::cout << width << "x" << height << " " << (format == 3 ? "QOI" : profileNames[format]) << ": "
+					  << duration.count() * 1000 / nbIterations << " ms, "
+					  << megabytes * nbIterations / duration.count() << " MB/s, " << encoded.size() << " bytes"
+					  << std::endl;
+		}
+	}
+}
+
+// Random sequences of given size. Pixel buffers are kept in given vector.
+std::vector<Sequence> makeRandomSequences(int nbSequences, int width, int height, std::vector<std::vector<int>>& pixels) {
+	std::vector<Sequence> sequences((size_t) nbSequences);
+	size_t size = (size_t) width * height;
+	pixels.assign((size_t) nbSequences, std::vector<int>(4 * size));
+	unsigned int seed = 1;
+	for (int k = 0; k < nbSequences; ++k) {
+		for (int& value : pixels[k]) {
+			seed = seed * 1103515245 + 12345;
+			value = (int) ((seed >> 16) % 256);
+		}
+		sequences[k].r = pixels[k].data();
+		sequences[k].g = pixels[k].data() + size;
+		sequences[k].b = pixels[k].data() + 2 * size;
+		sequences[k].i = pixels[k].data() + 3 * size;
+		sequences[k].score = 0;
+		sequences[k].classification = -1;
+	}
+	return sequences;
+}
+
+// Compare one classifySimilarities() call per row (one parallel region per row) with one call for all rows
+// (tiled pairs). Only first nbRows rows are compared, so that edges fit in memory for big collections.
+void benchmarkSimilarityScheduling(int nbSequences, int nbRows, int width, int height) {
+	std::vector<std::vector<int>> pixels;
+	std::vector<Sequence> sequences = makeRandomSequences(nbSequences, width, height, pixels);
+	std::vector<Sequence*> pSequences;
+	for (Sequence& sequence : sequences)
+		pSequences.push_back(&sequence);
+	nbRows = std::min(nbRows, nbSequences);
+	std::vector<double> rowEdges((size_t) nbRows * nbSequences, 0);
+	std::vector<double> tiledEdges((size_t) nbRows * nbSequences, 0);
+	double nbPairs = (double) nbRows * (nbSequences - 1) - (double) nbRows * (nbRows - 1) / 2;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < nbRows; ++i)
+		classifySimilarities(pSequences.data(), nbSequences, i, i + 1, width, height, rowEdges.data());
+	std::chrono::duration<double> rowDuration = std::chrono::steady_clock::now() - start;
+	start = std::chrono::steady_clock::now();
+	classifySimilarities(pSequences.data(), nbSequences, 0, nbRows, width, height, tiledEdges.data());
+	std::chrono::duration<double> tiledDuration = std::chrono::steady_clock::now() - start;
+	std::cout << nbSequences << " sequences, " << nbRows << " rows, " << width << "x" << height
+			  << ": per row " << nbPairs / rowDuration.count() << " pairs/s, tiled "
+			  << nbPairs / tiledDuration.count() << " pairs/s"
+			  << (rowEdges == tiledEdges ? "" : " (MISMATCH)") << std::endl;
+}
+
+// Scheduling benchmark on small, medium and large collections of 32x32 sequences.
+void benchmarkSimilaritySchedulingSizes(int nbRows) {
+	for (int nbSequences : {2000, 10000, 50000})
+		benchmarkSimilarityScheduling(nbSequences, nbRows, 32, 32);
+}
+
+// Similarity score computed as in original compareFaster(): each pixel of p1 is compared to pixels of p2
+// in its 3x3 neighbourhood (clipped to image), each distance is moderated, and minimum is kept.
+double referenceSimilarity(const Sequence* p1, const Sequence* p2, int width, int height) {
+	const double v = 255 * 3;
+	const double b = v / 2;
+	double totalDistance = 0;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			double minDistance = -1;
+			for (int localY = std::max(0, y - 1); localY <= std::min(height - 1, y + 1); ++localY) {
+				for (int localX = std::max(0, x - 1); localX <= std::min(width - 1, x + 1); ++localX) {
+					int i1 = x + y * width;
+					int i2 = localX + localY * width;
+					double d = std::abs(p1->r[i1] - p2->r[i2]) + std::abs(p1->g[i1] - p2->g[i2])
+							   + std::abs(p1->b[i1] - p2->b[i2]);
+					d = (v + b) * d / (d + b);
+					if (minDistance < 0 || d < minDistance)
+						minDistance = d;
+				}
+			}
+			totalDistance += minDistance;
+		}
+	}
+	double maximumSimilarityScore = v * width * height;
+	return (maximumSimilarityScore - totalDistance) / maximumSimilarityScore;
+}
+
+// Check classifySimilarities() at each SIMD level against reference scores, for many image sizes.
+bool testSimilaritySimd() {
+	const int sizes[][2] = {{2, 2}, {3, 3}, {5, 4}, {9, 7}, {10, 10}, {17, 5}, {32, 32}, {33, 18}};
+	const double tolerance = 1e-9;
+	bool returnValue = true;
+	for (const auto& size : sizes) {
+		int width = size[0], height = size[1], nbSequences = 12;
+		std::vector<std::vector<int>> pixels;
+		std::vector<Sequence> sequences = makeRandomSequences(nbSequences, width, height, pixels);
+		std::vector<Sequence*> pSequences;
+		for (Sequence& sequence : sequences)
+			pSequences.push_back(&sequence);
+		for (int simd = SIMILARITY_SIMD_SCALAR; simd <= SIMILARITY_SIMD_AVX2; ++simd) {
+			std::vector<double> edges((size_t) nbSequences * nbSequences, 0);
+			setSimilaritySimd(simd);
+			classifySimilarities(pSequences.data(), nbSequences, 0, nbSequences, width, height, edges.data());
+			for (int i = 0; i < nbSequences; ++i) {
+				for (int j = i + 1; j < nbSequences; ++j) {
+					double expected = referenceSimilarity(&sequences[i], &sequences[j], width, height);
+					if (std::abs(edges[i * nbSequences + j] - expected) > tolerance) {
+						std::cout << "Similarity mismatch at " << width << "x" << height << ", SIMD level " << simd
+								  << ": " << edges[i * nbSequences + j] << " vs " << expected << std::endl;
+						returnValue = false;
+					}
+				}
+			}
+		}
+	}
+	setSimilaritySimd(SIMILARITY_SIMD_AVX2);
+	return returnValue;
+}
+
+// Time classifySimilarities() on all pairs of given number of sequences at each SIMD level.
+void benchmarkSimilaritySimd(int nbSequences, int width, int height) {
+	const char* names[] = {"scalar", "SSE4.1", "AVX2"};
+	std::vector<std::vector<int>> pixels;
+	std::vector<Sequence> sequences = makeRandomSequences(nbSequences, width, height, pixels);
+	std::vector<Sequence*> pSequences;
+	for (Sequence& sequence : sequences)
+		pSequences.push_back(&sequence);
+	std::vector<double> edges((size_t) nbSequences * nbSequences, 0);
+	double nbPairs = (double) nbSequences * (nbSequences - 1) / 2;
+	for (int simd = SIMILARITY_SIMD_SCALAR; simd <= SIMILARITY_SIMD_AVX2; ++simd) {
+		setSimilaritySimd(simd);
+		auto start = std::chrono::steady_clock::now();
+		classifySimilarities(pSequences.data(), nbSequences, 0, nbSequences, width, height, edges.data());
+		std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+		std::cout << width << "x" << height << " " << names[simd] << ": " << nbPairs / duration.count()
+				  << " pairs/s" << std::endl;
+	}
+	setSimilaritySimd(SIMILARITY_SIMD_AVX2);
+}
+
+// Check packed sequences give same edges as sequences, at each SIMD level.
+bool testPackedSimilarities() {
+	const int sizes[][2] = {{2, 2}, {3, 3}, {9, 7}, {32, 32}, {33, 18}};
+	bool returnValue = true;
+	for (const auto& size : sizes) {
+		int width = size[0], height = size[1], nbSequences = 20;
+		std::vector<std::vector<int>> pixels;
+		std::vector<Sequence> sequences = makeRandomSequences(nbSequences, width, height, pixels);
+		std::vector<Sequence*> pSequences;
+		for (Sequence& sequence : sequences)
+			pSequences.push_back(&sequence);
+		PackedSequences packed;
+		if (!PackedSequences_init(&packed, pSequences.data(), nbSequences, width, height)
+			|| (uintptr_t) packed.data % PACKED_SEQUENCE_ALIGNMENT)
+			return false;
+		for (int simd = SIMILARITY_SIMD_SCALAR; simd <= SIMILARITY_SIMD_AVX2; ++simd) {
+			std::vector<double> edges((size_t) nbSequences * nbSequences, 0);
+			std::vector<double> packedEdges((size_t) nbSequences * nbSequences, 0);
+			setSimilaritySimd(simd);
+			classifySimilarities(pSequences.data(), nbSequences, 0, nbSequences, width, height, edges.data());
+			classifyPackedSimilarities(&packed, 0, nbSequences, packedEdges.data());
+			if (edges != packedEdges) {
+				std::cout << "Packed similarity mismatch at " << width << "x" << height << ", SIMD level " << simd
+						  << std::endl;
+				returnValue = false;
+			}
+		}
+		PackedSequences_clear(&packed);
+	}
+	setSimilaritySimd(SIMILARITY_SIMD_AVX2);
+	return returnValue;
+}
+
+// Compare classifySimilarities() with classifyPackedSimilarities() on first nbRows rows of given collection.
+void benchmarkPackedSimilarities(int nbSequences, int nbRows, int width, int height) {
+	std::vector<std::vector<int>> pixels;
+	std::vector<Sequence> sequences = makeRandomSequences(nbSequences, width, height, pixels);
+	std::vector<Sequence*> pSequences;
+	for (Sequence& sequence : sequences)
+		pSequences.push_back(&sequence);
+	nbRows = std::min(nbRows, nbSequences);
+	std::vector<double> edges((size_t) nbRows * nbSequences, 0);
+	double nbPairs = (double) nbRows * (nbSequences - 1) - (double) nbRows * (nbRows - 1) / 2;
+	auto start = std::chrono::steady_clock::now();
+	classifySimilarities(pSequences.data(), nbSequences, 0, nbRows, width, height, edges.data());
+	std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	PackedSequences packed;
+	start = std::chrono::steady_clock::now();
+	PackedSequences_init(&packed, pSequences.data(), nbSequences, width, height);
+	std::chrono::duration<double> packDuration = std::chrono::steady_clock::now() - start;
+	start = std::chrono::steady_clock::now();
+	classifyPackedSimilarities(&packed, 0, nbRows, edges.data());
+	std::chrono::duration<double> packedDuration = std::chrono::steady_clock::now() - start;
+	std::cout << nbSequences << " sequences " << width << "x" << height << ": "
+			  << nbPairs / duration.count() << " pairs/s with " << (nbSequences * 3 * sizeof(int) * width * height >> 20)
+			  << " MiB, packed " << nbPairs / packedDuration.count() << " pairs/s with "
+			  << (packed.stride * nbSequences >> 20) << " MiB (packing " << packDuration.count() << " s)" << std::endl;
+	PackedSequences_clear(&packed);
+}
+
+// Sequences in clusters of near-duplicates: each cluster has a smooth random base image,
+// and each sequence adds small noise to it, like thumbnails of re-encoded copies of same video.
+std::vector<Sequence> makeClusteredSequences(int nbSequences, int width, int height, int clusterSize, int noise,
+											 std::vector<std::vector<int>>& pixels) {
+	std::vector<Sequence> sequences = makeRandomSequences(nbSequences, width, height, pixels);
+	size_t size = (size_t) width * height;
+	unsigned int seed = 7;
+	auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (int) ((seed >> 16) & 0x7fff); };
+	int coefficients[3][3];
+	for (int k = 0; k < nbSequences; ++k) {
+		if (k % clusterSize == 0)
+			for (auto& channel : coefficients)
+				for (int& coefficient : channel)
+					coefficient = random() % 256;
+		for (int c = 0; c < 3; ++c) {
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					int value = (coefficients[c][0] * x / width + coefficients[c][1] * y / height + coefficients[c][2])
+								% 256 + random() % (2 * noise + 1) - noise;
+					pixels[k][c * size + x + y * width] = std::min(std::max(value, 0), 255);
+				}
+			}
+		}
+	}
+	return sequences;
+}
+
+// Check pruned classification keeps exactly pairs at or above threshold, with same scores.
+bool testSimilarityPruning(double minSimilarity) {
+	int width = 32, height = 32, nbSequences = 60;
+	std::vector<std::vector<int>> pixels;
+	std::vector<Sequence> sequences = makeClusteredSequences(nbSequences, width, height, 4, 8, pixels);
+	std::vector<Sequence*> pSequences;
+	for (Sequence& sequence : sequences)
+		pSequences.push_back(&sequence);
+	std::vector<double> edges((size_t) nbSequences * nbSequences, 0);
+	std::vector<double> prunedEdges((size_t) nbSequences * nbSequences, 0);
+	SimilarityPruning pruning;
+	classifySimilarities(pSequences.data(), nbSequences, 0, nbSequences, width, height, edges.data());
+	classifySimilaritiesAbove(pSequences.data(), nbSequences, 0, nbSequences, width, height, minSimilarity,
+							  prunedEdges.data(), &pruning);
+	int64_t nbSurvivors = 0;
+	for (int i = 0; i < nbSequences; ++i) {
+		for (int j = i + 1; j < nbSequences; ++j) {
+			double expected = edges[i * nbSequences + j] >= minSimilarity ? edges[i * nbSequences + j] : SIMILARITY_PRUNED;
+			if (prunedEdges[i * nbSequences + j] != expected)
+				return false;
+			nbSurvivors += expected != SIMILARITY_PRUNED;
+		}
+	}
+	return pruning.nbPairs == nbSequences * (nbSequences - 1) / 2 && pruning.nbSurvivors == nbSurvivors;
+}
+
+// Time full and pruned classification on a clustered collection, and print fraction of work skipped.
+void benchmarkSimilarityPruning(int nbSequences, int clusterSize, int noise, double minSimilarity) {
+	int width = 32, height = 32;
+	std::vector<std::vector<int>> pixels;
+	std::vector<Sequence> sequences = makeClusteredSequences(nbSequences, width, height, clusterSize, noise, pixels);
+	std::vector<Sequence*> pSequences;
+	for (Sequence& sequence : sequences)
+		pSequences.push_back(&sequence);
+	std::vector<double> edges((size_t) nbSequences * nbSequences, 0);
+	SimilarityPruning pruning;
+	auto start = std::chrono::steady_clock::now();
+	classifySimilarities(pSequences.data(), nbSequences, 0, nbSequences, width, height, edges.data());
+	std::chrono::duration<double> fullDuration = std::chrono::steady_clock::now() - start;
+	start = std::chrono::steady_clock::now();
+	classifySimilaritiesAbove(pSequences.data(), nbSequences, 0, nbSequences, width, height, minSimilarity,
+							  edges.data(), &pruning);
+	std::chrono::duration<double> prunedDuration = std::chrono::steady_clock::now() - start;
+	std::cout << nbSequences << " sequences, threshold " << minSimilarity << ": full " << fullDuration.count()
+			  << " s, pruned " << prunedDuration.count() << " s, " << pruning.nbSurvivors << "/" << pruning.nbPairs
+			  << " pairs kept, " << pruning.workSkipped * 100 << "% of work skipped" << std::endl;
+}
+
+// Check sparse classification returns kept pairs of dense classification, reduced to top-K neighbours
+// of each sequence if topK > 0. Sequence and packed inputs must give same edges.
+bool testSparseSimilarities(double minSimilarity, int topK) {
+	int width = 32, height = 32, nbSequences = 60;
+	std::vector<std::vector<int>> pixels;
+	std::vector<Sequence> sequences = makeClusteredSequences(nbSequences, width, height, 4, 8, pixels);
+	std::vector<Sequence*> pSequences;
+	for (Sequence& sequence : sequences)
+		pSequences.push_back(&sequence);
+	std::vector<double> edges((size_t) nbSequences * nbSequences, 0);
+	classifySimilaritiesAbove(pSequences.data(), nbSequences, 0, nbSequences, width, height, minSimilarity,
+							  edges.data(), nullptr);
+	// Reference: rank neighbours of each sequence by score, then by index.
+	std::vector<bool> expected((size_t) nbSequences * nbSequences, false);
+	for (int k = 0; k < nbSequences; ++k) {
+		std::vector<std::pair<double, int>> neighbours;
+		for (int other = 0; other < nbSequences; ++other) {
+			if (other == k)
+				continue;
+			double score = edges[std::min(k, other) * nbSequences + std::max(k, other)];
+			if (score != SIMILARITY_PRUNED)
+				neighbours.emplace_back(-score, other);
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		for (size_t rank = 0; rank < neighbours.size() && (topK <= 0 || (int) rank < topK); ++rank) {
+			int other = neighbours[rank].second;
+			expected[std::min(k, other) * nbSequences + std::max(k, other)] = true;
+		}
+	}
+	SimilarityEdges sparseEdges;
+	SimilarityEdges packedEdges;
+	PackedSequences packed;
+	SimilarityPruning pruning;
+	classifySimilaritiesSparse(pSequences.data(), nbSequences, 0, nbSequences, width, height, minSimilarity, topK,
+							   &sparseEdges, &pruning);
+	bool success = PackedSequences_init(&packed, pSequences.data(), nbSequences, width, height);
+	if (success) {
+		classifyPackedSimilaritiesSparse(&packed, 0, nbSequences, minSimilarity, topK, &packedEdges, nullptr);
+		PackedSequences_clear(&packed);
+		success = packedEdges.nbEdges == sparseEdges.nbEdges;
+		for (size_t e = 0; success && e < sparseEdges.nbEdges; ++e)
+			success = packedEdges.edges[e].i == sparseEdges.edges[e].i
+					  && packedEdges.edges[e].j == sparseEdges.edges[e].j
+					  && packedEdges.edges[e].score == sparseEdges.edges[e].score;
+		SimilarityEdges_clear(&packedEdges);
+	}
+	size_t nbExpected = 0;
+	for (bool kept : expected)
+		nbExpected += kept;
+	success = success && sparseEdges.nbEdges == nbExpected;
+	for (size_t e = 0; success && e < sparseEdges.nbEdges; ++e) {
+		const SimilarityEdge& edge = sparseEdges.edges[e];
+		success = expected[edge.i * nbSequences + edge.j] && edge.score == edges[edge.i * nbSequences + edge.j]
+				  && (e == 0 || sparseEdges.edges[e - 1].i < edge.i
+					  || (sparseEdges.edges[e - 1].i == edge.i && sparseEdges.edges[e - 1].j < edge.j));
+	}
+	SimilarityEdges_clear(&sparseEdges);
+	return success;
+}
+
+// Time dense and sparse classification on a clustered collection, and print memory used by each output.
+void benchmarkSparseSimilarities(int nbSequences, int clusterSize, double minSimilarity, int topK) {
+	int width = 32, height = 32;
+	std::vector<std::vector<int>> pixels;
+	std::vector<Sequence> sequences = makeClusteredSequences(nbSequences, width, height, clusterSize, 8, pixels);
+	std::vector<Sequence*> pSequences;
+	for (Sequence& sequence : sequences)
+		pSequences.push_back(&sequence);
+	SimilarityEdges sparseEdges;
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::vector<double> edges((size_t) nbSequences * nbSequences, 0);
+		classifySimilaritiesAbove(pSequences.data(), nbSequences, 0, nbSequences, width, height, minSimilarity,
+								  edges.data(), nullptr);
+	}
+	std::chrono::duration<double> denseDuration = std::chrono::steady_clock::now() - start;
+	start = std::chrono::steady_clock::now();
+	classifySimilaritiesSparse(pSequences.data(), nbSequences, 0, nbSequences, width, height, minSimilarity, topK,
+							   &sparseEdges, nullptr);
+	std::chrono::duration<double> sparseDuration = std::chrono::steady_clock::now() - start;
+	std::cout << nbSequences << " sequences, threshold " << minSimilarity << ", top " << topK << ": dense "
+			  << denseDuration.count() << " s, " << (size_t) nbSequences * nbSequences * sizeof(double)
+			  << " bytes, sparse " << sparseDuration.count() << " s, " << sparseEdges.nbEdges << " edges, "
+			  << sparseEdges.nbEdges * sizeof(SimilarityEdge) << " bytes" << std::endl;
+	SimilarityEdges_clear(&sparseEdges);
+}
+
 void testErrorPrinting() {
 	std::cout << "Testing errors printing ..." << std::endl;
 	unsigned int errors = ERROR_OPEN_FILE | ERROR_CODE_000000032 | ERROR_CONVERT_CODEC_PARAMS | ERROR_PNG_CODEC;
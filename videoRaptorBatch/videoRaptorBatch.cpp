@@ -2,33 +2,48 @@
 // Created by notoraptor on 27/05/2018.
 //
 
+#include <chrono>
 #include <cmath>
+#include <limits>
 #include <string>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <omp.h>
+#include <core/BatchScheduler.hpp>
+#include <core/ThumbnailPack.hpp>
 #include <core/Video.hpp>
+#include <core/WorkerResources.hpp>
 #include <core/errorCodes.hpp>
 #include "videoRaptorBatch.hpp"
 
-typedef bool (* VideoWorkerFunction)(Video* video, void* context);
+typedef bool (* VideoWorkerFunction)(Video* video, void* context, VideoRaptorOptions* options,
+									 WorkerResources& resources);
 
-bool videoWorkerForInfo(Video* video, void* context) {
-	video->extractInfo((VideoInfo*) context);
-	return true;
+bool videoWorkerForThumbnail(Video* video, void* context, VideoRaptorOptions* options, WorkerResources& resources) {
+	bool done = video->generateThumbnail((VideoThumbnail*) context, options, resources);
+	#pragma omp atomic
+	options->nbThumbnailPackets += video->countSentPackets();
+	return done;
 }
 
-bool videoWorkerForThumbnail(Video* video, void* context) {
-	return video->generateThumbnail((VideoThumbnail*) context);
+bool videoWorkerForFrames(Video* video, void* context, VideoRaptorOptions* options, WorkerResources& resources) {
+	bool done = video->generateFrames((VideoFrames*) context, options, resources);
+	#pragma omp atomic
+	options->nbThumbnailPackets += video->countSentPackets();
+	return done;
 }
 
 bool workOnVideo(HWDevices& devices, const char* videoFilename, VideoReport* videoReport, void* videoContext,
-				 VideoWorkerFunction videoWorkerFunction) {
+				 VideoRaptorOptions* options, WorkerResources& resources, VideoWorkerFunction videoWorkerFunction) {
+	// Index may be updated concurrently by other workers, so we read it once.
+	size_t indexStart = devices.indexUsed;
 	for (size_t i = 0; i < devices.available.size(); ++i) {
-		size_t indexToUse = (devices.indexUsed + i) % devices.available.size();
+		size_t indexToUse = (indexStart + i) % devices.available.size();
 		VideoReport_init(videoReport);
-		Video video(videoFilename, videoReport, devices, indexToUse);
+		Video video(videoFilename, videoReport, devices, indexToUse, options);
 		if (VideoReport_hasError(videoReport)) {
 			if (VideoReport_hasDeviceError(videoReport)) {
 				// Device error when loading video: move to next loop step.
@@ -38,7 +53,7 @@ bool workOnVideo(HWDevices& devices, const char* videoFilename, VideoReport* vid
 			return false;
 		}
 		// Video loaded. Do work.
-		if (!videoWorkerFunction(&video, videoContext)) {
+		if (!videoWorkerFunction(&video, videoContext, options, resources)) {
 			if (VideoReport_hasDeviceError(videoReport)) {
 				// Device error when working: move to next loop step.
 				continue;
@@ -53,42 +68,280 @@ bool workOnVideo(HWDevices& devices, const char* videoFilename, VideoReport* vid
 	// Device error for all devices. Don't use devices. Set index to invalid value.
 	devices.indexUsed = devices.available.size();
 	VideoReport_init(videoReport);
-	Video video(videoFilename, videoReport, devices, devices.indexUsed);
+	Video video(videoFilename, videoReport, devices, devices.available.size(), options);
 	if (VideoReport_hasError(videoReport))
 		return false;
-	return videoWorkerFunction(&video, videoContext);
+	return videoWorkerFunction(&video, videoContext, options, resources);
 }
 
-int videoRaptorThumbnails(int length, VideoThumbnail** pVideoThumbnail) {
-	if (length <= 0 || !pVideoThumbnail)
-		return 0;
+bool thumbnailTask(HWDevices& devices, VideoRaptorOptions* options, WorkerResources& resources,
+				   VideoThumbnail* videoThumbnail) {
+	return videoThumbnail
+		   && videoThumbnail->filename
+		   && (videoThumbnail->inMemory || resources.pack || (videoThumbnail->thumbnailFolder && videoThumbnail->thumbnailName))
+		   && workOnVideo(devices, videoThumbnail->filename, &videoThumbnail->report, videoThumbnail,
+						  options, resources, videoWorkerForThumbnail);
+}
+
+bool framesTask(HWDevices& devices, VideoRaptorOptions* options, WorkerResources& resources,
+				VideoFrames* videoFrames) {
+	return videoFrames
+		   && videoFrames->filename
+		   && videoFrames->thumbnailFolder
+		   && videoFrames->thumbnailName
+		   && videoFrames->nbFrames > 0
+		   && workOnVideo(devices, videoFrames->filename, &videoFrames->report, videoFrames,
+						  options, resources, videoWorkerForFrames);
+}
+
+bool detailsTask(HWDevices&, VideoRaptorOptions* options, WorkerResources&, VideoInfo* videoDetails) {
+	if (!videoDetails || !videoDetails->filename)
+		return false;
+	// Info extraction does not need decoders, so hardware devices are not used.
+	VideoReport_init(&videoDetails->report);
+	Video video(videoDetails->filename, &videoDetails->report, options);
+	if (video.hasProbeRetried()) {
+		#pragma omp atomic
+		++options->nbProbeRetries;
+	}
+	if (VideoReport_hasError(&videoDetails->report))
+		return false;
+	video.extractInfo(videoDetails);
+	return true;
+}
+
+// Estimated cost of each batch item (see estimateVideoCost()).
+template <typename T>
+std::vector<size_t> estimateBatchCosts(int length, T** items) {
+	std::vector<size_t> costs((size_t) length);
+	for (int i = 0; i < length; ++i)
+		costs[i] = items[i] ? estimateVideoCost(items[i]->filename) : 0;
+	return costs;
+}
+
+// Share processors between workers (many videos in parallel) and decoding threads (one video decoded in parallel).
+// By default, each video gets its own worker, up to one worker per processor. If batch contains large videos
+// (see LARGE_VIDEO_COST), workers are limited so that each one gets at least LARGE_VIDEO_DECODE_THREADS processors,
+// and, if a few videos make most of batch cost, to about as many workers as such videos (total cost / largest cost).
+// Processors left go to decoders and PNG encoder.
+void distributeThreads(VideoRaptorOptions* options, const std::vector<size_t>& costs) {
+	int length = (int) costs.size();
+	int nbProcessors = omp_get_num_procs();
+	int nbWorkers = options->nbWorkers;
+	if (nbWorkers <= 0 && options->nbDecodeThreads > 0) {
+		nbWorkers = nbProcessors / options->nbDecodeThreads;
+	} else if (nbWorkers <= 0) {
+		nbWorkers = nbProcessors;
+		size_t largestCost = 0;
+		double totalCost = 0;
+		for (size_t cost : costs) {
+			largestCost = std::max(largestCost, cost);
+			totalCost += cost;
+		}
+		if (largestCost >= LARGE_VIDEO_COST) {
+			nbWorkers = std::min(nbWorkers, nbProcessors / LARGE_VIDEO_DECODE_THREADS);
+			nbWorkers = std::min(nbWorkers, (int) std::ceil(totalCost / largestCost));
+		}
+	}
+	nbWorkers = std::max(1, std::min(nbWorkers, length));
+	int nbDecodeThreads = options->nbDecodeThreads;
+	if (nbDecodeThreads <= 0)
+		nbDecodeThreads = std::max(1, nbProcessors / nbWorkers);
+	int nbEncodeThreads = options->nbEncodeThreads;
+	if (nbEncodeThreads <= 0)
+		nbEncodeThreads = std::max(1, nbProcessors / nbWorkers);
+	options->nbWorkersUsed = nbWorkers;
+	options->nbDecodeThreadsUsed = nbDecodeThreads;
+	options->nbEncodeThreadsUsed = nbEncodeThreads;
+}
+
+// Add counters from worker resources to batch outputs.
+void collectWorkerCounters(VideoRaptorOptions* options, const WorkerResources& resources) {
+	#pragma omp atomic
+	options->nbScalerHits += resources.scalers.hits;
+	#pragma omp atomic
+	options->nbScalerMisses += resources.scalers.misses;
+	#pragma omp atomic
+	options->nbPoolAllocations += resources.frames.allocations;
+}
+
+// Run task on all items, with threads already distributed into options by distributeThreads().
+// costs are estimated costs of items, used by work stealing scheduler.
+template <typename T>
+int runWorkers(int length, T** items, VideoRaptorOptions* options, bool (* task)(HWDevices&, VideoRaptorOptions*, WorkerResources&, T*),
+			   const std::vector<size_t>& costs, ThumbnailPackWriter* pack, EncodePipeline* encoder) {
 	HWDevices* devices = getHardwareDevices();
+	int nbWorkers = options->nbWorkersUsed;
 	int countLoaded = 0;
-	for (int i = 0; i < length; ++i) {
-		VideoThumbnail* videoThumbnail = pVideoThumbnail[i];
-		if (videoThumbnail
-			&& videoThumbnail->filename
-			&& videoThumbnail->thumbnailFolder
-			&& videoThumbnail->thumbnailName
-			&& workOnVideo(*devices, videoThumbnail->filename, &videoThumbnail->report, videoThumbnail,
-						   videoWorkerForThumbnail))
-			++countLoaded;
+	// Time when each worker runs out of videos, to measure batch tail.
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double firstDone = std::numeric_limits<double>::max();
+	double lastDone = 0;
+	// Each item only writes into its own report, so items can be handled in any order.
+	if (options->scheduler == SCHEDULER_STATIC) {
+		#pragma omp parallel num_threads(nbWorkers) reduction(+:countLoaded) reduction(min:firstDone) reduction(max:lastDone) default(none) shared(length, items, task, devices, options, pack, encoder, start)
+		{
+			WorkerResources resources(pack, encoder);
+			// OpenMP may grant fewer threads than requested (nested region, thread limit),
+			// so ranges are split between threads actually running.
+			int worker = omp_get_thread_num();
+			int nbThreads = omp_get_num_threads();
+			int from = (int) ((int64_t) length * worker / nbThreads);
+			int to = (int) ((int64_t) length * (worker + 1) / nbThreads);
+			for (int i = from; i < to; ++i) {
+				if (task(*devices, options, resources, items[i]))
+					++countLoaded;
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			firstDone = lastDone = elapsed.count();
+			collectWorkerCounters(options, resources);
+		}
+	} else {
+		BatchScheduler scheduler(costs, nbWorkers);
+		#pragma omp parallel num_threads(nbWorkers) reduction(+:countLoaded) reduction(min:firstDone) reduction(max:lastDone) default(none) shared(items, task, devices, options, scheduler, pack, encoder, start)
+		{
+			WorkerResources resources(pack, encoder);
+			int worker = omp_get_thread_num();
+			int i;
+			while (scheduler.next(worker, &i)) {
+				if (task(*devices, options, resources, items[i]))
+					++countLoaded;
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			firstDone = lastDone = elapsed.count();
+			collectWorkerCounters(options, resources);
+		}
 	}
+	options->firstWorkerDoneTime = firstDone;
+	options->lastWorkerDoneTime = lastDone;
 	return countLoaded;
 }
 
-int videoRaptorDetails(int length, VideoInfo** pVideoInfo) {
-	if (length <= 0 || !pVideoInfo)
+template <typename T>
+int runBatch(int length, T** items, VideoRaptorOptions* options, bool (* task)(HWDevices&, VideoRaptorOptions*, WorkerResources&, T*)) {
+	VideoRaptorOptions defaultOptions;
+	if (!options) {
+		VideoRaptorOptions_init(&defaultOptions);
+		options = &defaultOptions;
+	}
+	std::vector<size_t> costs = estimateBatchCosts(length, items);
+	distributeThreads(options, costs);
+	return runWorkers(length, items, options, task, costs, nullptr, nullptr);
+}
+
+int videoRaptorThumbnailsWithOptions(int length, VideoThumbnail** pVideoThumbnail, VideoRaptorOptions* options) {
+	if (length <= 0 || !pVideoThumbnail)
 		return 0;
-	HWDevices* devices = getHardwareDevices();
-	int countLoaded = 0;
-	for (int i = 0; i < length; ++i) {
-		VideoInfo* videoDetails = pVideoInfo[i];
-		if (videoDetails
-			&& videoDetails->filename
-			&& workOnVideo(*devices, videoDetails->filename, &videoDetails->report, videoDetails, videoWorkerForInfo))
-			++countLoaded;
+	if (!options || (!options->thumbnailPack && options->encodeQueueSize <= 0))
+		return runBatch(length, pVideoThumbnail, options, thumbnailTask);
+	// Threads are distributed once, before encoder stage is sized from workers count.
+	std::vector<size_t> costs = estimateBatchCosts(length, pVideoThumbnail);
+	distributeThreads(options, costs);
+	// Thumbnails still buffered when workers end are written by close(), which marks them failed on error.
+	// Encoder stage must be closed before pack, as encoders append to pack.
+	std::unique_ptr<ThumbnailPackWriter> pack;
+	std::unique_ptr<EncodePipeline> encoder;
+	if (options->thumbnailPack)
+		pack.reset(new ThumbnailPackWriter(options->thumbnailPack));
+	if (options->encodeQueueSize > 0) {
+		int nbEncoders = options->nbEncoders > 0 ? options->nbEncoders : std::max(1, options->nbWorkersUsed / 2);
+		encoder.reset(new EncodePipeline((size_t) options->encodeQueueSize, nbEncoders, options, pack.get()));
+	}
+	int countLoaded = runWorkers(length, pVideoThumbnail, options, thumbnailTask, costs, pack.get(), encoder.get());
+	if (encoder) {
+		encoder->endDecoding();
+		countLoaded -= encoder->close(options);
 	}
+	if (pack)
+		countLoaded -= pack->close();
 	return countLoaded;
 }
 
+int videoRaptorFrames(int length, VideoFrames** pVideoFrames, VideoRaptorOptions* options) {
+	if (length <= 0 || !pVideoFrames)
+		return 0;
+	return runBatch(length, pVideoFrames, options, framesTask);
+}
+
+int videoRaptorDetailsWithOptions(int length, VideoInfo** pVideoInfo, VideoRaptorOptions* options) {
+	if (length <= 0 || !pVideoInfo)
+		return 0;
+	return runBatch(length, pVideoInfo, options, detailsTask);
+}
+
+int videoRaptorThumbnails(int length, VideoThumbnail** pVideoThumbnail) {
+	return videoRaptorThumbnailsWithOptions(length, pVideoThumbnail, nullptr);
+}
+
+int videoRaptorDetails(int length, VideoInfo** pVideoInfo) {
+	return videoRaptorDetailsWithOptions(length, pVideoInfo, nullptr);
+}
+
+void ThumbnailPackRecord_set(ThumbnailPackRecord* record, const ThumbnailPackEntry& entry) {
+	record->filename = entry.filename.c_str();
+	record->offset = entry.offset;
+	record->dataSize = (size_t) entry.size;
+	record->timestamp = entry.timestamp;
+	record->width = (int) entry.width;
+	record->height = (int) entry.height;
+	record->format = (int) entry.format;
+}
+
+void* ThumbnailPack_open(const char* packFilename) {
+	if (!packFilename)
+		return nullptr;
+	ThumbnailPackReader* reader = new ThumbnailPackReader(packFilename);
+	if (!reader->isOpen()) {
+		delete reader;
+		return nullptr;
+	}
+	return reader;
+}
+
+void ThumbnailPack_close(void* pack) {
+	delete (ThumbnailPackReader*) pack;
+}
+
+int ThumbnailPack_count(void* pack) {
+	if (!pack)
+		return 0;
+	return (int) ((ThumbnailPackReader*) pack)->getEntries().size();
+}
+
+bool ThumbnailPack_getRecord(void* pack, int index, ThumbnailPackRecord* record) {
+	if (!pack || !record)
+		return false;
+	const std::vector<ThumbnailPackEntry>& entries = ((ThumbnailPackReader*) pack)->getEntries();
+	if (index < 0 || (size_t) index >= entries.size())
+		return false;
+	ThumbnailPackRecord_set(record, entries[index]);
+	return true;
+}
+
+bool ThumbnailPack_find(void* pack, const char* videoFilename, ThumbnailPackRecord* record) {
+	if (!pack || !videoFilename || !record)
+		return false;
+	const ThumbnailPackEntry* entry = ((ThumbnailPackReader*) pack)->find(videoFilename);
+	if (!entry)
+		return false;
+	ThumbnailPackRecord_set(record, *entry);
+	return true;
+}
+
+unsigned char* ThumbnailPack_read(void* pack, const ThumbnailPackRecord* record) {
+	if (!pack || !record)
+		return nullptr;
+	ThumbnailPackEntry entry;
+	entry.offset = record->offset;
+	entry.size = record->dataSize;
+	std::vector<unsigned char> data;
+	if (!((ThumbnailPackReader*) pack)->read(entry, data))
+		return nullptr;
+	unsigned char* output = new unsigned char[data.size() ? data.size() : 1];
+	std::copy(data.begin(), data.end(), output);
+	return output;
+}
+
+void ThumbnailPack_free(unsigned char* data) {
+	delete[] data;
+}
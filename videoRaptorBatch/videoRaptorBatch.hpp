@@ -7,10 +7,33 @@
 
 #include <core/VideoInfo.hpp>
 #include <core/VideoThumbnail.hpp>
+#include <core/VideoFrames.hpp>
+#include <core/ThumbnailPackRecord.hpp>
+#include <core/VideoRaptorOptions.hpp>
 
 extern "C" {
 	int videoRaptorDetails(int length, VideoInfo** pVideoInfo);
 	int videoRaptorThumbnails(int length, VideoThumbnail** pVideoThumbnail);
+	// Same as above, with given options. If options is null, default options are used.
+	int videoRaptorDetailsWithOptions(int length, VideoInfo** pVideoInfo, VideoRaptorOptions* options);
+	int videoRaptorThumbnailsWithOptions(int length, VideoThumbnail** pVideoThumbnail, VideoRaptorOptions* options);
+	// Generate many frames per video, opening each video once. If options is null, default options are used.
+	int videoRaptorFrames(int length, VideoFrames** pVideoFrames, VideoRaptorOptions* options);
+	// Read a thumbnail pack written with options.thumbnailPack. Return null if pack cannot be opened.
+	// Returned pack must be closed with ThumbnailPack_close(). Functions are not thread-safe for a same pack.
+	// Functions below return 0, false or null if pack, record or video filename is null.
+	void* ThumbnailPack_open(const char* packFilename);
+	void ThumbnailPack_close(void* pack);
+	// Number of records in pack, including older records of videos written many times.
+	int ThumbnailPack_count(void* pack);
+	// Get record at given index, in writing order. Return false if index is out of bounds.
+	bool ThumbnailPack_getRecord(void* pack, int index, ThumbnailPackRecord* record);
+	// Get latest record of given video. Return false if video has no thumbnail in pack.
+	bool ThumbnailPack_find(void* pack, const char* videoFilename, ThumbnailPackRecord* record);
+	// Read encoded thumbnail of given record (record->dataSize bytes). Return null if thumbnail cannot be read.
+	// Free returned data with ThumbnailPack_free().
+	unsigned char* ThumbnailPack_read(void* pack, const ThumbnailPackRecord* record);
+	void ThumbnailPack_free(unsigned char* data);
 };
 
 